@@ -187,15 +187,18 @@ class FlagsDataSource(DataSource):
 
     def _parse_record(self, chunk):
         tmp =  struct.unpack(self.record_format, chunk)
-        flags = tmp[0]
-        interesting_flags = flags & MASK_OF_INTERESTING_FLAGS
-        if FlagsDataSource._instances.has_key(interesting_flags):
-            instance =  FlagsDataSource._instances[interesting_flags]
-        else:
-            instance =  KPageFlags(flags)
-            FlagsDataSource._instances[interesting_flags] = instance
-
-        return instance
+        return get_kpageflags(tmp[0])
+
+def get_kpageflags(flags):
+    """ The shared KPageFlags instance for the (raw) `flags`, masked with the current filter """
+    interesting_flags = flags & MASK_OF_INTERESTING_FLAGS
+    if FlagsDataSource._instances.has_key(interesting_flags):
+        instance =  FlagsDataSource._instances[interesting_flags]
+    else:
+        instance =  KPageFlags(flags)
+        FlagsDataSource._instances[interesting_flags] = instance
+
+    return instance
 
 class KPageFlags:
 
@@ -0,0 +1,567 @@
+#!/usr/bin/env python
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+
+"""
+ Live page-state monitor: rereads /proc/kpageflags and /proc/kpagecount (or
+ the page state of the phys_mem module) chunk by chunk in a rolling cycle
+ and keeps the page-flags/page-count histograms and the per-region state in
+ memory. Nothing is written to disk, unless an image is requested.
+
+ No per-frame state is kept: each chunk is remembered by a checksum of its
+ records and its contribution to the statistics (a few hundred bytes per
+ chunk). Only the chunks whose checksum changed since the last cycle touch
+ the statistics.
+
+ The analyzers (FlagsAggregator, FlagsPainter, ...) read the state through
+ `LiveMonitor.flags_source()`/`count_source()` just like a pair of snapshot
+ files; these sources reread the frames.
+"""
+
+import os
+import sys
+import time
+import struct
+import zlib
+from array import array
+
+import kpageflags
+from kpageflags import *
+from flag_stats import FlagsAggregator
+from optparse import OptionParser
+
+
+# Classes of the per-region state, see `classify`
+REGION_NOPAGE     = 0
+REGION_FREE       = 1
+REGION_SLAB       = 2
+REGION_ANON       = 3
+REGION_PAGE_CACHE = 4
+REGION_OTHER      = 5
+
+REGION_CLASS_NAMES = ('nopage', 'free', 'slab', 'anon', 'page cache', 'other')
+NUM_REGION_CLASSES = len(REGION_CLASS_NAMES)
+
+def _uint32_typecode():
+    """ The array typecode of a 32 bit unsigned integer ('L' is 64 bit on LP64) """
+    for typecode in ('I', 'L'):
+        if 4 == array(typecode).itemsize:
+            return typecode
+    raise TypeError("no 32 bit array typecode")
+
+UINT32 = _uint32_typecode()
+
+def classify(flags):
+    """ The region class of the (unfiltered) page-flags of a frame """
+    if flags & NOPAGE:
+        return REGION_NOPAGE
+    if flags & BUDDY:
+        return REGION_FREE
+    if flags & SLAB:
+        return REGION_SLAB
+    if flags & ANON:
+        return REGION_ANON
+    if flags & LRU:
+        return REGION_PAGE_CACHE
+    return REGION_OTHER
+
+
+class ProcChunkReader:
+    """
+    Reads `kpageflags`/`kpagecount` records of a range of frames. The files
+    stay open, each chunk is one seek and one read per file.
+
+    Also works on snapshot files written by `collect_kpage.sh`.
+    """
+
+    def __init__(self, flags_path = "/proc/kpageflags", count_path = "/proc/kpagecount"):
+        self.flags_file = open(flags_path, 'rb')
+        self.count_file = open(count_path, 'rb')
+
+    def read(self, start, num):
+        """
+        Returns (flags, counts, digest) of the frames start..start+num-1.
+        Flags and counts are shorter than `num` at the end of the physical
+        memory, the digest is a checksum (32 bit) of both.
+        """
+        flags = self._read(self.flags_file, start, num)
+        counts = self._read(self.count_file, start, num)
+
+        size = min(len(flags), len(counts))
+        flags = flags[:size]
+        counts = counts[:size]
+        num = size / 8
+        return struct.unpack("%dQ" % (num,), flags), struct.unpack("%dQ" % (num,), counts), zlib.crc32(counts, zlib.crc32(flags)) & 0xffffffff
+
+    def _read(self, f, start, num):
+        f.seek(start * 8)
+        chunk = f.read(num * 8)
+        return chunk[:len(chunk) & ~7]
+
+    def close(self):
+        self.flags_file.close()
+        self.count_file.close()
+
+
+class ModuleChunkReader:
+    """
+    Reads the flags and map counts of a range of frames from the page state
+    of the phys_mem module (one ioctl per chunk). Flags and counts of a chunk
+    are consistent with each other.
+    """
+
+    def __init__(self, device, num_frames):
+        self.device = device
+        self.num_frames = num_frames
+
+    def read(self, start, num):
+        num = min(num, self.num_frames - start)
+        if num <= 0:
+            return (), (), 0
+
+        states = self.device.page_state(start, num)
+        flags = [state.flags for state in states]
+        counts = [state.count for state in states]
+        return flags, counts, zlib.crc32(struct.pack("%dQ" % (len(counts),), *counts), zlib.crc32(struct.pack("%dQ" % (len(flags),), *flags))) & 0xffffffff
+
+    def close(self):
+        pass
+
+
+def count_frames(reader, chunk_frames = 1 << 16):
+    """ Number of frames described by `reader` (reads all of it once) """
+    num_frames = 0
+    while True:
+        flags, counts, digest = reader.read(num_frames, chunk_frames)
+        num_frames += len(flags)
+        if len(flags) < chunk_frames:
+            return num_frames
+
+
+class _ChunkSummary:
+    """
+    What the monitor remembers of a chunk: the checksum of its records and
+    its contribution to the statistics. `region_frames` holds the frames per
+    class of each region the chunk overlaps, region by region.
+    """
+
+    __slots__ = ('num_frames', 'digest', 'flag_counts', 'page_counts', 'region_frames')
+
+    def __init__(self, num_frames, digest, flag_counts, page_counts, region_frames):
+        self.num_frames = num_frames
+        self.digest = digest
+        self.flag_counts = flag_counts
+        self.page_counts = page_counts
+        self.region_frames = region_frames
+
+
+class LiveMonitor:
+    """
+    Keeps, for each chunk, a checksum and its contribution to
+
+     - `pf_statistics`: masked page-flags -> number of frames
+     - `pc_statistics`: page count -> number of frames
+     - `region_frames[class]`: number of frames of the class (REGION_*) in
+       each region of 2^region_order frames
+
+    `step()` rereads the next chunk of `chunk_frames` frames. If its checksum
+    changed, the old contribution of the chunk is taken out of the
+    statistics and the new one added. The first cycle discovers the number
+    of frames.
+
+    The histogram is keyed by the flags masked with the filter of
+    `kpageflags` at the time they were read; call `rebuild()` after
+    changing the filter.
+    """
+
+    def __init__(self, reader, chunk_frames = 1 << 14, region_order = 9):
+        self.reader = reader
+        self.chunk_frames = chunk_frames
+        self.region_order = region_order
+
+        self.frames = 0
+        self.chunks = []
+
+        self.pf_statistics = {}
+        self.pc_statistics = {}
+        self.region_frames = [ array(UINT32) for name in REGION_CLASS_NAMES ]
+
+        self.cursor = 0
+        self.cycles = 0
+        self.changed = 0
+        self.changed_last_cycle = 0
+        self.cycle_started = time.time()
+        self.last_cycle_duration = 0
+
+    def num_frames(self):
+        return self.frames
+
+    def num_regions(self):
+        return len(self.region_frames[0])
+
+    def step(self):
+        """
+        Read and account the next chunk. Returns True if this completed a
+        cycle over all frames.
+        """
+        flags, counts, digest = self.reader.read(self.cursor, self.chunk_frames)
+        num = len(flags)
+
+        if num:
+            self._update(self.cursor, flags, counts, digest)
+            self.cursor += num
+
+        if num < self.chunk_frames:
+            self.cursor = 0
+            self.cycles += 1
+            self.changed_last_cycle = self.changed
+            self.changed = 0
+
+            now = time.time()
+            self.last_cycle_duration = now - self.cycle_started
+            self.cycle_started = now
+            return True
+
+        return False
+
+    def run(self, cycle_seconds, on_cycle = None, max_cycles = 0):
+        """
+        Reread all frames every `cycle_seconds`, spreading the chunks evenly
+        over the cycle. The first cycle runs at full speed. `on_cycle(self)`
+        is called after each completed cycle.
+        """
+        while not max_cycles or self.cycles < max_cycles:
+            started = time.time()
+            completed = self.step()
+
+            if completed and on_cycle:
+                on_cycle(self)
+
+            if self.cycles and self.frames:
+                chunk_seconds = cycle_seconds * self.chunk_frames / float(self.frames)
+                delay = chunk_seconds - (time.time() - started)
+                if delay > 0:
+                    time.sleep(delay)
+
+    def _update(self, start, flags, counts, digest):
+        """ Account the chunk starting at `start` (a multiple of chunk_frames) """
+        index = start / self.chunk_frames
+
+        if index < len(self.chunks):
+            old = self.chunks[index]
+            if old.digest == digest and old.num_frames == len(flags):
+                return
+            self.changed += 1
+            self._account(start, old, -1)
+        else:
+            old = None
+
+        self.frames = max(self.frames, start + len(flags))
+        num_regions = ((self.frames - 1) >> self.region_order) + 1
+        for frames in self.region_frames:
+            if len(frames) < num_regions:
+                frames.extend([0] * (num_regions - len(frames)))
+
+        summary = self._summarize(start, flags, counts, digest)
+        self._account(start, summary, 1)
+
+        if old:
+            self.chunks[index] = summary
+        else:
+            self.chunks.append(summary)
+
+    def _summarize(self, start, flags, counts, digest):
+        mask = kpageflags.MASK_OF_INTERESTING_FLAGS
+        order = self.region_order
+        first_region = start >> order
+        num_regions = ((start + len(flags) - 1) >> order) - first_region + 1
+
+        flag_counts = {}
+        page_counts = {}
+        region_frames = array(UINT32, [0]) * (num_regions * NUM_REGION_CLASSES)
+
+        for i in xrange(len(flags)):
+            f = flags[i]
+            masked = f & mask
+            flag_counts[masked] = flag_counts.get(masked, 0) + 1
+            c = counts[i]
+            page_counts[c] = page_counts.get(c, 0) + 1
+            region_frames[(((start + i) >> order) - first_region) * NUM_REGION_CLASSES + classify(f)] += 1
+
+        return _ChunkSummary(len(flags), digest, flag_counts, page_counts, region_frames)
+
+    def _account(self, start, summary, sign):
+        """ Add (sign 1) or take out (sign -1) the contribution of a chunk """
+        pf_statistics = self.pf_statistics
+        pc_statistics = self.pc_statistics
+
+        for key, n in summary.flag_counts.iteritems():
+            pf_statistics[key] = pf_statistics.get(key, 0) + sign * n
+        for key, n in summary.page_counts.iteritems():
+            pc_statistics[key] = pc_statistics.get(key, 0) + sign * n
+
+        first_region = start >> self.region_order
+        region_frames = summary.region_frames
+        for i in xrange(len(region_frames)):
+            n = region_frames[i]
+            if n:
+                self.region_frames[i % NUM_REGION_CLASSES][first_region + i / NUM_REGION_CLASSES] += sign * n
+
+    def rebuild(self):
+        """ Recompute all statistics, rereading all frames """
+        self.frames = 0
+        self.chunks = []
+        self.pf_statistics = {}
+        self.pc_statistics = {}
+        self.region_frames = [ array(UINT32) for name in REGION_CLASS_NAMES ]
+
+        start = 0
+        while True:
+            flags, counts, digest = self.reader.read(start, self.chunk_frames)
+            if len(flags):
+                self._update(start, flags, counts, digest)
+            start += len(flags)
+            if len(flags) < self.chunk_frames:
+                break
+
+    def flag_histogram(self):
+        """ KPageFlags -> number of frames, like FlagsAggregator.pf_statistics """
+        return dict( (get_kpageflags(k), v) for k, v in self.pf_statistics.iteritems() if v )
+
+    def count_histogram(self):
+        return dict( (k, v) for k, v in self.pc_statistics.iteritems() if v )
+
+    def region_summary(self):
+        """
+        For each region class (name): (number of regions consisting only of
+        frames of this class, number of regions containing frames of this class)
+        """
+        region_size = 1 << self.region_order
+        last_size = self.frames - ((self.num_regions() - 1) << self.region_order)
+
+        summary = []
+        for cls in xrange(len(REGION_CLASS_NAMES)):
+            frames = self.region_frames[cls]
+            num_pure = sum(1 for n in frames if n == region_size)
+            if frames and frames[-1] == last_size and last_size != region_size:
+                num_pure += 1
+            num_any = sum(1 for n in frames if n)
+            summary.append((REGION_CLASS_NAMES[cls], num_pure, num_any))
+
+        return summary
+
+    def flags_source(self):
+        """
+        The page-flags as DataSource for BaseAnalyzer.analyze. Reread chunk
+        by chunk while iterating, i.e. the current state.
+        """
+        return _ChunkSource(self, 0, get_kpageflags)
+
+    def count_source(self):
+        """ The page counts as DataSource for BaseAnalyzer.analyze, see flags_source() """
+        return _ChunkSource(self, 1, None)
+
+    def analyze(self, analyzer):
+        """ Run a BaseAnalyzer over the current state of all frames """
+        flags_source = self.flags_source()
+        count_source = self.count_source()
+        # One read per chunk for both sources
+        count_source.chunk = flags_source.chunk
+        analyzer.analyze(flags_source, count_source)
+
+    def print_status(self):
+        print("cycle %d: %d frames, %d of %d chunks changed in %.1f s" % (self.cycles, self.frames, self.changed_last_cycle, len(self.chunks), self.last_cycle_duration))
+
+        aggregator = FlagsAggregator(False, False)
+        aggregator.pf_statistics = self.flag_histogram()
+        aggregator.print_status()
+
+        print("%d regions of %d frames:" % (self.num_regions(), 1 << self.region_order))
+        for name, num_pure, num_any in self.region_summary():
+            print("%12s \t %d only, %d some" % (name, num_pure, num_any))
+
+
+class _Chunk:
+    """ The last chunk read for the sources of a monitor """
+
+    def __init__(self, monitor):
+        self.monitor = monitor
+        self.start = 0
+        self.records = ((), ())
+
+    def record(self, pfn, field):
+        """ Record `field` (0: flags, 1: counts) of `pfn`, None past the end """
+        monitor = self.monitor
+        if not (self.start <= pfn < self.start + len(self.records[0])):
+            if pfn >= monitor.frames:
+                return None
+            self.start = pfn - pfn % monitor.chunk_frames
+            flags, counts, digest = monitor.reader.read(self.start, monitor.chunk_frames)
+            self.records = (flags, counts)
+            if not (self.start <= pfn < self.start + len(flags)):
+                return None
+        return self.records[field][pfn - self.start]
+
+
+class _ChunkSource:
+    """
+    Iterates over a field of the frames of the monitor like DataSource
+    iterates over a file, rereading them chunk by chunk. Records are
+    converted with `parse` (if set).
+    """
+
+    def __init__(self, monitor, field, parse):
+        self.chunk = _Chunk(monitor)
+        self.field = field
+        self.parse = parse
+        self.index = 0
+
+    def open(self):
+        self.index = 0
+        return self
+
+    def close(self):
+        pass
+
+    def next_record(self):
+        record = self[self.index]
+        if None != record:
+            self.index += 1
+        return record
+
+    def __getitem__(self, pfn):
+        record = self.chunk.record(pfn, self.field)
+        if None != record and self.parse:
+            return self.parse(record)
+        return record
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, type, value, traceback):
+        pass
+
+
+def open_module_reader(path):
+    """ Reads the page state from the phys_mem module (see collect_kpage.sh for the pylib) """
+    pylib = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', '..', '..', 'physmem', 'interface', 'src', 'pylib')
+    if pylib not in sys.path:
+        sys.path.append(pylib)
+    import physmem
+
+    proc = ProcChunkReader()
+    try:
+        num_frames = count_frames(proc)
+    finally:
+        proc.close()
+
+    return ModuleChunkReader(physmem.Physmem(path), num_frames)
+
+
+if __name__ == "__main__":
+    #
+    usage = """This tool monitors `kpageflags`/`kpagecount` without writing snapshots.
+    usage: %prog [options]"""
+    parser = OptionParser(usage=usage)
+
+    parser.add_option("-t", "--cycle",
+                      default=10.0, type=float,
+                      metavar="SECONDS", help="Reread all frames every SECONDS. [default: %default]")
+
+    parser.add_option("-k", "--chunk",
+                      default=1 << 14, type=int,
+                      metavar="FRAMES", help="Number of frames read at once. [default: %default]")
+
+    parser.add_option("-r", "--region-order",
+                      default=9, type=int,
+                      metavar="ORDER", help="Regions of 2^ORDER frames for the per-region state. [default: %default]")
+
+    parser.add_option("-n", "--cycles",
+                      default=0, type=int,
+                      metavar="CYCLES", help="Stop after CYCLES cycles (0: never). [default: %default]")
+
+    parser.add_option("-m", "--module", action="store_true", dest="module",
+                      default=False,
+                      help="Read the page state from /dev/phys_mem instead of /proc. [default: %default]")
+
+    parser.add_option("-d", "--dir",
+                      default=None,
+                      metavar="DIR", help="Replay the first kpageflags/kpagecount pair found in DIR instead of /proc. [default: %default]")
+
+    parser.add_option("-f", "--flags-image",
+                      default=None,
+                      metavar="FILE", help="Repaint the page flags (like `flag_painter.py -f`) into FILE after each cycle. [default: %default]")
+
+    parser.add_option("-x", "--x-res",
+                      default=1280, type=int, dest="x",
+                      metavar="RESOLUTION-X", help="Horizontal resolution of the image. [default: %default]")
+
+    parser.add_option("-y", "--y-res", dest="y",
+                      default=820, type=int,
+                      metavar="RESOLUTION-Y", help="Vertical resolution of the image. [default: %default]")
+
+    (options, args) = parser.parse_args()
+
+    if len(args) != 0:
+        parser.error("incorrect number of arguments")
+
+    if options.module:
+        reader = open_module_reader("/dev/phys_mem")
+    elif options.dir:
+        import glob
+        from file_utils import FileSetIterator
+        file_sets = list(FileSetIterator(glob.glob(os.path.join(options.dir, '*kpage*.bin'))))
+        if not file_sets:
+            parser.error("no kpageflags/kpagecount files in %s" % (options.dir,))
+        reader = ProcChunkReader(*file_sets[0])
+    else:
+        reader = ProcChunkReader()
+
+    on_cycle = LiveMonitor.print_status
+
+    if options.flags_image:
+        import flag_painter
+        from PIL import ImageFont
+        from canvas import MemoryCanvas
+
+        legend_font_path = "/opt/local/share/fonts/dejavu-fonts/DejaVuSansMono.ttf"
+        flag_painter.legend_font = ImageFont.truetype(legend_font_path, 14, encoding='unic')
+
+        set_interesting_pageflag_filter(  MMAP |   ANON )
+
+        flags_canvas = MemoryCanvas(options.x, options.y, 1, 0, background=flag_painter.background)
+        painter = flag_painter.build_flag_analyzer_static_colors(flags_canvas, flag_painter.legend_font)
+
+        def on_cycle(monitor):
+            monitor.print_status()
+            monitor.analyze(painter)
+            flags_canvas.save(options.flags_image)
+
+    monitor = LiveMonitor(reader, options.chunk, options.region_order)
+    try:
+        monitor.run(options.cycle, on_cycle, options.cycles)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        reader.close()
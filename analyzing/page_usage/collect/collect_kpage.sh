@@ -26,6 +26,10 @@
 #
 # The format of the filename is HOST_file@seconds since epoch.bin
 #
+# If the phys_mem module is loaded (/dev/phys_mem), both files are taken
+# from one consistent snapshot of the module (dump_page_state.py), which
+# also writes the extended records to HOST_pagestate@seconds since epoch.bin.
+#
 
 
 SLEEPTIME=1
@@ -67,9 +71,16 @@ BLOCKSIZE=1M
 # The current date in seconds since epoch
 postfix_generator="date +%s"
 
+PYLIB=$(dirname $0)/../../../physmem/interface/src/pylib
+DUMP_PAGE_STATE=$(dirname $0)/../../../physmem/interface/src/bin/dump_page_state.py
+
 function dump
 {
         postfix=$($postfix_generator)
+	if [ -w /dev/phys_mem ]
+	then
+		PYTHONPATH=$PYLIB python $DUMP_PAGE_STATE $outdir $postfix && return
+	fi
 	for file in /proc/kpageflags /proc/kpagecount
 	do
 	 outfile_name=$(hostname -s)_$(basename $file)@${postfix}.bin
@@ -0,0 +1,243 @@
+/*
+ * Probe the physical address bits that select the DRAM bank/channel.
+ *
+ * Two addresses in the same bank but in different rows cause a row buffer
+ * conflict when they are accessed alternately: each access has to close the
+ * open row and activate a new one. This is measurably slower than accessing
+ * two addresses in different banks (or in the same row).
+ *
+ * 1) Allocate a large buffer and translate it to physical addresses via
+ *    /proc/self/pagemap (needs root).
+ * 2) For every bit >= PAGE_SHIFT, time frame pairs that differ in exactly
+ *    that bit. A "fast" bit toggles some bank/channel function, a "slow" bit
+ *    is a pure row bit.
+ * 3) For every pair of fast bits, time frame pairs that differ in exactly
+ *    these two bits. A slow pair means that both bits are XORed into the
+ *    same function (toggling both leaves the bank unchanged).
+ *
+ * Column bits above PAGE_SHIFT (if any) also look "fast"; reporting them as a
+ * function is harmless for the ordering.
+ *
+ * The result is printed in the format expected by `main.py --interleave-map`.
+ * Channels, ranks and banks cannot be told apart by latency, so all functions
+ * are reported as `bank`. The scheduler only needs to know which frames are
+ * on different units.
+ *
+ *   gcc -O2 -o interleave_probe interleave_probe.c
+ *   sudo ./interleave_probe [buffer size in MB]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <x86intrin.h>
+
+#define PAGESIZE    (4096)
+#define PAGE_SHIFT  (12)
+#define MAX_BIT     (40)
+
+#define ROUNDS      (1000)
+#define MAX_PAIRS   (16)
+
+struct frame {
+    uint64_t phys;
+    volatile char* virt;
+};
+
+static struct frame* frames;
+static size_t num_frames;
+
+static int compare_frames(const void* a, const void* b)
+{
+    uint64_t pa = ((const struct frame*) a)->phys;
+    uint64_t pb = ((const struct frame*) b)->phys;
+
+    return (pa > pb) - (pa < pb);
+}
+
+static struct frame* find_frame(uint64_t phys)
+{
+    struct frame key;
+
+    key.phys = phys;
+    return bsearch(&key, frames, num_frames, sizeof (struct frame), compare_frames);
+}
+
+/*
+ * Average cycles for ROUNDS alternating, uncached accesses to a and b
+ */
+static uint64_t time_pair(volatile char* a, volatile char* b)
+{
+    uint64_t start, total = 0;
+    unsigned int aux;
+    int i;
+
+    for (i = 0; i < ROUNDS; i++) {
+        _mm_clflush((void*) a);
+        _mm_clflush((void*) b);
+        _mm_mfence();
+
+        start = __rdtscp(&aux);
+        (void) *a;
+        (void) *b;
+        total += __rdtscp(&aux) - start;
+    }
+    return total / ROUNDS;
+}
+
+/*
+ * Median of the timings of up to MAX_PAIRS frame pairs whose physical
+ * addresses differ in exactly the bits in `mask`. Returns 0 if no such pair
+ * exists in the buffer.
+ */
+static uint64_t time_mask(uint64_t mask)
+{
+    uint64_t samples[MAX_PAIRS];
+    int num_samples = 0;
+    size_t i;
+
+    for (i = 0; i < num_frames && num_samples < MAX_PAIRS; i++) {
+        struct frame* other;
+
+        if (frames[i].phys & mask)
+            continue;
+
+        other = find_frame(frames[i].phys | mask);
+        if (other) {
+            int j;
+            uint64_t t = time_pair(frames[i].virt, other->virt);
+
+            /* insertion sort */
+            for (j = num_samples; j > 0 && samples[j - 1] > t; j--)
+                samples[j] = samples[j - 1];
+            samples[j] = t;
+            num_samples++;
+        }
+    }
+    return num_samples ? samples[num_samples / 2] : 0;
+}
+
+static int translate(char* buffer, size_t size)
+{
+    int pagemap;
+    size_t i;
+
+    pagemap = open("/proc/self/pagemap", O_RDONLY);
+    if (pagemap < 0) {
+        perror("Error opening /proc/self/pagemap");
+        return -1;
+    }
+
+    num_frames = size / PAGESIZE;
+    frames = calloc(num_frames, sizeof (struct frame));
+    if (!frames) {
+        close(pagemap);
+        return -1;
+    }
+
+    for (i = 0; i < num_frames; i++) {
+        uint64_t entry;
+        off_t offset = ((uintptr_t) buffer / PAGESIZE + i) * sizeof (entry);
+
+        if (pread(pagemap, &entry, sizeof (entry), offset) != sizeof (entry)) {
+            perror("Error reading /proc/self/pagemap");
+            close(pagemap);
+            return -1;
+        }
+
+        /* bit 63: present, bits 0-54: pfn (0 if not root) */
+        frames[i].phys = (entry & ((1ULL << 55) - 1)) << PAGE_SHIFT;
+        frames[i].virt = buffer + i * PAGESIZE;
+
+        if (!(entry & (1ULL << 63)) || !frames[i].phys) {
+            fprintf(stderr, "No physical address for the buffer. Run as root.\n");
+            close(pagemap);
+            return -1;
+        }
+    }
+    close(pagemap);
+
+    qsort(frames, num_frames, sizeof (struct frame), compare_frames);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t size = (argc > 1 ? atol(argv[1]) : 1024) * 1024 * 1024;
+    uint64_t single[MAX_BIT];
+    uint64_t base, threshold;
+    int fast_bits[MAX_BIT];
+    int num_fast = 0;
+    int in_function[MAX_BIT];
+    int printed = 0;
+    char* buffer;
+    int bit, i, j;
+
+    buffer = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (buffer == MAP_FAILED) {
+        perror("Error mmapping");
+        exit(EXIT_FAILURE);
+    }
+    memset(buffer, 1, size);
+
+    if (translate(buffer, size))
+        exit(EXIT_FAILURE);
+
+    /*
+     * Pairs in the same page are row buffer hits: the fast baseline.
+     */
+    base = time_pair(frames[0].virt, frames[0].virt + 64);
+
+    for (bit = PAGE_SHIFT; bit < MAX_BIT; bit++) {
+        single[bit] = time_mask(1ULL << bit);
+        if (single[bit])
+            fprintf(stderr, "bit %2d: %4llu cycles\n", bit, (unsigned long long) single[bit]);
+    }
+
+    /* Row conflicts are the slowest pairs, bank parallel pairs the fastest. */
+    threshold = 0;
+    for (bit = PAGE_SHIFT; bit < MAX_BIT; bit++)
+        if (single[bit] > threshold)
+            threshold = single[bit];
+    threshold = (threshold + base) / 2;
+    fprintf(stderr, "baseline %llu cycles, conflict threshold %llu cycles\n", (unsigned long long) base, (unsigned long long) threshold);
+
+    for (bit = PAGE_SHIFT; bit < MAX_BIT; bit++)
+        if (single[bit] && single[bit] < threshold)
+            fast_bits[num_fast++] = bit;
+
+    memset(in_function, 0, sizeof (in_function));
+
+    printf("bank=");
+    for (i = 0; i < num_fast; i++) {
+        if (in_function[fast_bits[i]])
+            continue;
+
+        if (printed++)
+            printf(",");
+        printf("%d", fast_bits[i]);
+        in_function[fast_bits[i]] = 1;
+
+        for (j = i + 1; j < num_fast; j++) {
+            uint64_t t;
+
+            if (in_function[fast_bits[j]])
+                continue;
+
+            t = time_mask((1ULL << fast_bits[i]) | (1ULL << fast_bits[j]));
+            if (t && t >= threshold) {
+                printf("^%d", fast_bits[j]);
+                in_function[fast_bits[j]] = 1;
+            }
+        }
+    }
+    printf("\n");
+
+    munmap(buffer, size);
+    free(frames);
+    return 0;
+}
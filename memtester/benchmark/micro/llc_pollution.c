@@ -0,0 +1,261 @@
+/*
+ * Measure how much each test kernel variant (scheduler/src/tester/native)
+ * slows down a cache sensitive foreground workload.
+ *
+ * The foreground workload is a random pointer chase over a working set that
+ * fits into the last level cache. It runs on one CPU while a background
+ * thread on another CPU (sharing the LLC) tests a large buffer with one of
+ * the kernel variants. For each variant the benchmark reports
+ *
+ *  - the foreground throughput (chase steps/s) and the slowdown compared to
+ *    an idle background,
+ *  - the LLC misses per 1000 foreground steps (perf_event_open, needs
+ *    perf_event_paranoid <= 1 or root; "n/a" otherwise),
+ *  - the test throughput of the background thread.
+ *
+ * All variants run the same algorithm, so the variant with the smallest
+ * slowdown has the smallest cache footprint at equal detection power.
+ *
+ *   gcc -O2 -msse4.1 -pthread -I../../scheduler/src/tester/native \
+ *       -o llc_pollution llc_pollution.c ../../scheduler/src/tester/native/testkernels.c
+ *   ./llc_pollution [working set in KB] [test buffer in MB] [seconds per run]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "testkernels.h"
+
+#define PAGESIZE        (4096)
+#define CACHE_LINE      (64)
+
+/* The background thread tests the buffer in chunks of this size (a blockwise scheduler block) */
+#define CHUNK_SIZE      (64 * PAGESIZE)
+
+#define VARIANT_IDLE    (-1)
+
+struct background {
+    pthread_t thread;
+    int variant;
+    char* buffer;
+    size_t size;
+    volatile int stop;
+    uint64_t bytes_tested;
+    long num_errors;
+};
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void pin_to_cpu(int cpu)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof (set), &set))
+        fprintf(stderr, "Could not pin to cpu %d, results will be noisy\n", cpu);
+}
+
+/*
+ * LLC read misses of the calling thread, -1 if not available
+ */
+static int open_llc_miss_counter(void)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof (attr));
+    attr.size = sizeof (attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void* background_main(void* arg)
+{
+    struct background* bg = arg;
+    size_t offset = 0;
+
+    pin_to_cpu(1);
+
+    while (!bg->stop) {
+        long errors = testkernel_linear(bg->variant, bg->buffer + offset, CHUNK_SIZE, NULL, 0);
+
+        if (errors > 0)
+            bg->num_errors += errors;
+
+        bg->bytes_tested += CHUNK_SIZE;
+        offset = (offset + CHUNK_SIZE) % bg->size;
+    }
+    return NULL;
+}
+
+/*
+ * Build a random cyclic permutation of the cache lines of the working set,
+ * so that the hardware prefetchers cannot predict the next access.
+ */
+static void** build_chase(size_t working_set)
+{
+    size_t num_lines = working_set / CACHE_LINE;
+    size_t* order;
+    char* lines;
+    size_t i;
+
+    if (posix_memalign((void**) &lines, PAGESIZE, working_set))
+        return NULL;
+
+    order = malloc(num_lines * sizeof (size_t));
+    if (!order) {
+        free(lines);
+        return NULL;
+    }
+
+    for (i = 0; i < num_lines; i++)
+        order[i] = i;
+
+    for (i = num_lines - 1; i > 0; i--) {
+        size_t j = random() % (i + 1);
+        size_t t = order[i];
+
+        order[i] = order[j];
+        order[j] = t;
+    }
+
+    for (i = 0; i < num_lines; i++)
+        *(void**) (lines + order[i] * CACHE_LINE) = lines + order[(i + 1) % num_lines] * CACHE_LINE;
+
+    free(order);
+    return (void**) lines;
+}
+
+static void run(int variant, void** chase, char* buffer, size_t buffer_size, double seconds, double idle_steps_per_second, double* steps_per_second)
+{
+    struct background bg;
+    int counter = open_llc_miss_counter();
+    uint64_t steps = 0;
+    long long misses = 0;
+    double start, elapsed;
+    void** p = chase;
+    int i;
+
+    memset(&bg, 0, sizeof (bg));
+    bg.variant = variant;
+    bg.buffer = buffer;
+    bg.size = buffer_size;
+
+    if (variant != VARIANT_IDLE && pthread_create(&bg.thread, NULL, background_main, &bg)) {
+        perror("Error creating the background thread");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Warm up the working set (and give the background thread time to start) */
+    for (i = 0; i < 1000000; i++)
+        p = (void**) *p;
+
+    if (counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    start = now();
+    do {
+        for (i = 0; i < 100000; i++)
+            p = (void**) *p;
+        steps += 100000;
+        elapsed = now() - start;
+    } while (elapsed < seconds);
+
+    if (counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counter, &misses, sizeof (misses)) != sizeof (misses))
+            misses = -1;
+        close(counter);
+    }
+
+    if (variant != VARIANT_IDLE) {
+        bg.stop = 1;
+        pthread_join(bg.thread, NULL);
+    }
+
+    *steps_per_second = steps / elapsed;
+
+    printf("%-14s %14.0f %9.1f%% ", variant == VARIANT_IDLE ? "idle" : testkernel_name(variant),
+            *steps_per_second, idle_steps_per_second ? 100.0 * (1.0 - *steps_per_second / idle_steps_per_second) : 0.0);
+
+    if (counter >= 0 && misses >= 0)
+        printf("%14.2f ", 1000.0 * misses / steps);
+    else
+        printf("%14s ", "n/a");
+
+    printf("%12.1f", bg.bytes_tested / elapsed / (1024 * 1024));
+    if (bg.num_errors)
+        printf("  (%ld bad words!)", bg.num_errors);
+    printf("\n");
+
+    /* keep the chase alive */
+    if (!p)
+        printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    size_t working_set = (argc > 1 ? atol(argv[1]) : 4096) * 1024;
+    size_t buffer_size = (argc > 2 ? atol(argv[2]) : 256) * 1024 * 1024;
+    double seconds = argc > 3 ? atof(argv[3]) : 5.0;
+    double idle_steps_per_second, steps_per_second;
+    void** chase;
+    char* buffer;
+    int variant;
+
+    if (working_set < PAGESIZE || buffer_size < CHUNK_SIZE) {
+        fprintf(stderr, "usage: %s [working set in KB] [test buffer in MB] [seconds per run]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    buffer_size -= buffer_size % CHUNK_SIZE;
+
+    pin_to_cpu(0);
+
+    chase = build_chase(working_set);
+    if (!chase) {
+        perror("Error allocating the working set");
+        exit(EXIT_FAILURE);
+    }
+
+    buffer = mmap(0, buffer_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (buffer == MAP_FAILED) {
+        perror("Error mmapping");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("working set %zu KB, test buffer %zu MB, %.1f s per run\n", working_set / 1024, buffer_size / (1024 * 1024), seconds);
+    printf("%-14s %14s %10s %14s %12s\n", "variant", "fg steps/s", "slowdown", "LLC miss/1000", "test MB/s");
+
+    run(VARIANT_IDLE, chase, buffer, buffer_size, seconds, 0, &idle_steps_per_second);
+
+    for (variant = 0; variant < TESTKERNEL_NUM_VARIANTS; variant++)
+        run(variant, chase, buffer, buffer_size, seconds, idle_steps_per_second, &steps_per_second);
+
+    munmap(buffer, buffer_size);
+    free(chase);
+    return 0;
+}
@@ -0,0 +1,344 @@
+#!/usr/bin/python
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+
+"""
+ Scalability benchmark of the scheduler overhead on synthetic inputs.
+
+ Generates synthetic /proc/kpageflags, /proc/kpagecount and status files for
+ a series of RAM sizes, flag mixes and hole layouts, and runs the scheduling
+ and statistics paths of scheduler/src against them with an emulated
+ /dev/phys_mem (claims are decided by the flags, nothing is mapped or
+ tested). Each pass runs in its own process and reports its CPU time and
+ peak RSS, so that the growth with the RAM size can be read off, and
+ extrapolated to the sizes of large hosts:
+
+   ./scheduler_scale.py --sizes 1G,2G,4G,8G --extrapolate 4T
+
+ The generated files of the largest size need 32 bytes per 4 KiB frame
+ (kpageflags, kpagecount, status) in --workdir.
+"""
+
+import os
+import sys
+import random
+import resource
+import struct
+import subprocess
+import tempfile
+import time
+import shutil
+from ctypes import sizeof
+from optparse import OptionParser
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, "..", "..", "scheduler", "src"))
+sys.path.insert(0, os.path.join(HERE, "..", "..", "..", "physmem", "interface", "src", "pylib"))
+
+import kpage
+import physmem
+import status
+import scheduling.blockwise
+import scheduling.fragmentation
+
+PAGE_SIZE = 4096
+
+# kpageflags of the synthetic usage classes
+FLAGS_BY_CLASS = {
+    "buddy" : kpage.kpageflags.BUDDY,
+    "lru" : kpage.kpageflags.LRU | kpage.kpageflags.UPTODATE | kpage.kpageflags.MMAP,
+    "anon" : kpage.kpageflags.LRU | kpage.kpageflags.ANON | kpage.kpageflags.MMAP | kpage.kpageflags.SWAPBACKED,
+    "slab" : kpage.kpageflags.SLAB,
+    "reserved" : 0,
+}
+
+PASSES = ["num_frames", "print_stats", "blockwise", "fragmentation"]
+
+# Frames of a run of equal flags: up to a pageblock
+MAX_RUN = 512
+
+
+def parse_size(s):
+    units = {"K" : 1 << 10, "M" : 1 << 20, "G" : 1 << 30, "T" : 1 << 40}
+    s = s.strip().upper()
+    if s[-1] in units:
+        return int(float(s[:-1]) * units[s[-1]])
+    return int(s)
+
+
+def parse_mix(s):
+    """
+    "buddy=0.4,lru=0.3" -> [(flags, cumulative probability), ..]
+    """
+    mix = []
+    total = 0.0
+    for item in s.split(","):
+        (name, fraction) = item.split("=")
+        if name not in FLAGS_BY_CLASS:
+            raise ValueError("Unknown flag class %s, expected one of %s" % (name, ", ".join(FLAGS_BY_CLASS.keys())))
+        total += float(fraction)
+        mix.append((FLAGS_BY_CLASS[name], total))
+    return [(flags, cumulative / total) for (flags, cumulative) in mix]
+
+
+def generate(workdir, num_frames, mix, hole_fraction, num_holes, tested_fraction, seed):
+    """
+    Write kpageflags, kpagecount and a blockwise status file with
+    num_frames frames. The flags come in runs of random length drawn from
+    `mix`. `num_holes` holes (NOPAGE) cover hole_fraction of the frames.
+    """
+    rnd = random.Random(seed)
+    hole_frames = int(num_frames * hole_fraction)
+    holes = []
+    if num_holes and hole_frames:
+        hole_size = max(1, hole_frames // num_holes)
+        for start in sorted(rnd.sample(xrange(0, num_frames // MAX_RUN), num_holes)):
+            holes.append((start * MAX_RUN, start * MAX_RUN + hole_size))
+
+    now = time.time() * 100
+    frame_status = scheduling.blockwise.get_frame_config_class()
+    header = status.StatusFileHeader()
+    header.initialize(sizeof(frame_status), now - 8640000)
+    record = frame_status.bind(header)()
+    untested = buffer(record)[:]
+
+    paths = [os.path.join(workdir, name) for name in ("kpageflags", "kpagecount", "status")]
+    with open(paths[0], "wb") as flags_file:
+        with open(paths[1], "wb") as count_file:
+            with open(paths[2], "wb") as status_file:
+                status_file.write(buffer(header)[:])
+                pfn = 0
+                while pfn < num_frames:
+                    run = min(rnd.randint(1, MAX_RUN), num_frames - pfn)
+
+                    if holes and holes[0][0] <= pfn:
+                        (start, end) = holes.pop(0)
+                        run = max(1, min(end, num_frames) - pfn)
+                        flags = kpage.kpageflags.NOPAGE
+                    else:
+                        r = rnd.random()
+                        flags = [f for (f, cumulative) in mix if r <= cumulative][0]
+
+                    count = (flags & kpage.kpageflags.MMAP) and 1 or 0
+                    flags_file.write(struct.pack("Q", flags) * run)
+                    count_file.write(struct.pack("Q", count) * run)
+
+                    if rnd.random() < tested_fraction:
+                        record.last_successfull_test = now - rnd.randint(0, 8640000)
+                        record.last_claiming_time_jiffies = rnd.randint(0, 3)
+                        record.last_claiming_attempt = now
+                        record.last_successfull_claiming_method = physmem.SOURCE_FREE_BUDDY_PAGE
+                        status_file.write(buffer(record)[:] * run)
+                    else:
+                        status_file.write(untested * run)
+                    pfn += run
+    return paths
+
+
+class EmulatedPhysmem(object):
+    '''
+    Stands in for physmem.Physmem: frames flagged BUDDY are "claimed", the
+    mapping is a dummy and no frame is touched.
+    '''
+
+    def __init__(self, kpageflags_path):
+        self.kpageflags_file = open(kpageflags_path, "rb")
+        self.config = []
+
+    def configure(self, requests):
+        self.config = []
+        offset = 0
+        for request in requests:
+            self.kpageflags_file.seek(request.requested_pfn * 8)
+            (flags,) = struct.unpack("Q", self.kpageflags_file.read(8))
+
+            answer = physmem.Phys_mem_frame_status()
+            answer.request = request
+            answer.pfn = request.requested_pfn
+            if flags & kpage.kpageflags.BUDDY:
+                answer.actual_source = physmem.SOURCE_FREE_BUDDY_PAGE
+                answer.page_p = 1
+                answer.vma_offset_of_first_byte = offset
+                offset += PAGE_SIZE
+            self.config.append(answer)
+
+    def read_configuration(self):
+        return self.config
+
+    def mark_pfn_bad(self, pfn):
+        pass
+
+    def mmap(self, length, offset = 0):
+        return _NullMapping()
+
+
+class _NullMapping(object):
+    def __enter__(self):
+        return self
+
+    def __exit__(self, type, value, traceback):
+        pass
+
+
+class NullTest(object):
+    FAULT_MODELS = 0
+
+    def test(self, map, offset, length):
+        return True
+
+    def name(self):
+        return "no test"
+
+
+class NullReporting(object):
+    def report_good_frame(self, pfn):
+        pass
+
+    def report_bad_frame(self, pfn):
+        pass
+
+
+def run_pass(name, paths, num_frames):
+    """
+    Runs in the child process
+    """
+    timestamping = status.TimestampingFacility()
+    cfg = status.FileBasedConfiguration(paths[2], num_frames, scheduling.blockwise.get_frame_config_class())
+
+    if "num_frames" == name:
+        with kpage.FlagsDataSource('flags', paths[0]).open() as pageflags:
+            pageflags.num_frames()
+
+    elif "print_stats" == name:
+        import main
+        stdout = sys.stdout
+        sys.stdout = open(os.devnull, "w")
+        try:
+            with cfg.open() as s:
+                main.print_stats(s, timestamping)
+        finally:
+            sys.stdout = stdout
+
+    elif "blockwise" == name:
+        pageflags = kpage.FlagsDataSource('flags', paths[0]).open()
+        pagecount = kpage.CountDataSource('count', paths[1]).open()
+        factory = scheduling.blockwise.SimpleBlockwiseSchedulerFactory(EmulatedPhysmem(paths[0]), NullTest(), pageflags, pagecount, timestamping, NullReporting())
+        with cfg.open() as s:
+            factory.new_instance(s).run(0, num_frames, physmem.SOURCE_FREE_BUDDY_PAGE)
+
+    elif "fragmentation" == name:
+        scheduling.fragmentation.PageblockOrder(paths[0]).order(0, num_frames)
+
+
+def measure(name, paths, num_frames):
+    """
+    Run the pass in a child process. Returns (cpu seconds, peak RSS in KiB)
+    """
+    child = subprocess.Popen([sys.executable, os.path.abspath(__file__), "--child", name, str(num_frames)] + paths)
+    (pid, exit_status, usage) = os.wait4(child.pid, 0)
+    if exit_status:
+        raise RuntimeError("Pass %s failed with %d" % (name, exit_status))
+    return (usage.ru_utime + usage.ru_stime, usage.ru_maxrss)
+
+
+def linear_fit(xs, ys):
+    n = float(len(xs))
+    mean_x = sum(xs) / n
+    mean_y = sum(ys) / n
+    var = sum([(x - mean_x) ** 2 for x in xs])
+    if not var:
+        return (0.0, mean_y)
+    slope = sum([(x - mean_x) * (y - mean_y) for (x, y) in zip(xs, ys)]) / var
+    return (slope, mean_y - slope * mean_x)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) > 1 and "--child" == sys.argv[1]:
+        run_pass(sys.argv[2], sys.argv[4:], int(sys.argv[3]))
+        sys.exit(0)
+
+    parser = OptionParser(usage = "%prog [options]")
+    parser.add_option("--sizes", dest="sizes", default="1G,2G,4G,8G",
+                      help="RAM sizes to emulate. [default: %default]")
+    parser.add_option("--mix", dest="mix", default="buddy=0.3,lru=0.35,anon=0.25,slab=0.08,reserved=0.02",
+                      help="Fraction of the frames per flag class (%s). [default: %%default]" % (", ".join(FLAGS_BY_CLASS.keys()),))
+    parser.add_option("--hole-fraction", dest="hole_fraction", type=float, default=0.02,
+                      help="Fraction of the pfn range without frames. [default: %default]")
+    parser.add_option("--holes", dest="num_holes", type=int, default=4,
+                      help="Number of holes. [default: %default]")
+    parser.add_option("--tested-fraction", dest="tested_fraction", type=float, default=0.5,
+                      help="Fraction of the frames already tested in the status file. [default: %default]")
+    parser.add_option("--passes", dest="passes", default=",".join(PASSES),
+                      help="Passes to run (%s). [default: %%default]" % (", ".join(PASSES),))
+    parser.add_option("--extrapolate", dest="extrapolate", default="4T",
+                      help="RAM size to extrapolate the results to (linear fit). [default: %default]")
+    parser.add_option("--workdir", dest="workdir", default=None,
+                      help="Directory for the generated files. [default: a temporary directory]")
+    parser.add_option("--seed", dest="seed", type=int, default=4711)
+
+    (options, args) = parser.parse_args()
+
+    try:
+        labels = options.sizes.split(",")
+        sizes = [parse_size(label) for label in labels]
+        mix = parse_mix(options.mix)
+        extrapolate = parse_size(options.extrapolate)
+    except ValueError as e:
+        parser.error(str(e))
+
+    passes = options.passes.split(",")
+    for name in passes:
+        if name not in PASSES:
+            parser.error("Unknown pass %s" % (name,))
+
+    workdir = options.workdir or tempfile.mkdtemp(prefix="scheduler_scale")
+    results = dict([(name, []) for name in passes])
+
+    print("%-8s %12s %-14s %10s %12s %12s" % ("RAM", "frames", "pass", "CPU s", "CPU ns/frame", "peak RSS MB"))
+    try:
+        for (label, size) in zip(labels, sizes):
+            num_frames = size // PAGE_SIZE
+            paths = generate(workdir, num_frames, mix, options.hole_fraction, options.num_holes, options.tested_fraction, options.seed)
+
+            for name in passes:
+                (cpu, rss_kb) = measure(name, paths, num_frames)
+                results[name].append((num_frames, cpu, rss_kb))
+                print("%-8s %12d %-14s %10.2f %12.1f %12.1f" % (label, num_frames, name, cpu, 1e9 * cpu / num_frames, rss_kb / 1024.0))
+                sys.stdout.flush()
+
+            for path in paths:
+                os.unlink(path)
+    finally:
+        if not options.workdir:
+            shutil.rmtree(workdir, True)
+
+    if len(sizes) > 1:
+        frames = extrapolate // PAGE_SIZE
+        print("\nExtrapolated to %s (%d frames), linear in the number of frames:" % (options.extrapolate, frames))
+        for name in passes:
+            xs = [float(r[0]) for r in results[name]]
+            (cpu_slope, cpu_offset) = linear_fit(xs, [r[1] for r in results[name]])
+            (rss_slope, rss_offset) = linear_fit(xs, [float(r[2]) for r in results[name]])
+            print("\t%-14s CPU %10.0f s   peak RSS %10.1f MB   (RSS growth: %.1f bytes/frame)" % (name, max(0.0, cpu_slope * frames + cpu_offset),
+                    max(0.0, rss_slope * frames + rss_offset) / 1024.0, rss_slope * 1024))
@@ -34,6 +34,13 @@ except ImportError as e:
 import status
 import scheduling
 import scheduling.simple.frame
+import scheduling.interleave
+import scheduling.selection
+import scheduling.fragmentation
+import scheduling.free_scan
+import scheduling.prediction
+import scheduling.slicing
+import scheduling.burn_in
 import sys
 import tester
 
@@ -144,6 +151,49 @@ def print_stats(config,timestamping):
         print("\tTime it took to claim a frame (in jiffies) (min,max,avg) : %d, %d, %d" % (min_claim_time, max_claim_time, total_claim_time / num_tested))   
         print("\tTimestamp of last test (min,max,avg) : %s, %s, %s" % (timestamping.to_string( min_last_test_timestamp, '-'), timestamping.to_string(max_last_test_timestamp), timestamping.to_string(total_last_test_timestamp / num_tested)))   
 
+def print_coverage_stats(coverage, timestamping):
+    """
+    Per fault model: how many frames are covered and the oldest coverage
+    """
+    num_frames = coverage.get_record_count()
+    num_covered = [0] * tester.fault_models.NUM_FAULT_MODELS
+    oldest = [None] * tester.fault_models.NUM_FAULT_MODELS
+
+    for pfn in xrange(0, num_frames):
+        frame_last_covered = coverage[pfn].last_covered
+        for index in xrange(0, tester.fault_models.NUM_FAULT_MODELS):
+            last_covered = frame_last_covered[index]
+            if last_covered > 0:
+                num_covered[index] += 1
+                if (oldest[index] is None) or (last_covered < oldest[index]):
+                    oldest[index] = last_covered
+
+    print("Fault model coverage:")
+    for (index, model) in enumerate(tester.fault_models.ALL_FAULT_MODELS):
+        if oldest[index] is None:
+            oldest_string = '-'
+        else:
+            oldest_string = timestamping.to_string(timestamping.seconds_to_timestamp(oldest[index]))
+        print("\t%-16s: %d frames (%02.1f %%), oldest coverage %s" % (tester.fault_models.FAULT_MODEL_NAMES[model], num_covered[index], (100.0 * num_covered[index] / num_frames), oldest_string))
+
+def print_backoff_stats(backoff, timestamping):
+    """
+    Per claim failure reason: how many frames are currently backed off
+    """
+    num_frames = backoff.get_record_count()
+    num_backing_off = [0] * len(physmem.CLAIM_FAILURE_NAMES)
+    now = timestamping.timestamp()
+
+    for pfn in xrange(0, num_frames):
+        frame = backoff[pfn]
+        if frame.is_backing_off(now) and frame.failure_reason < len(num_backing_off):
+            num_backing_off[frame.failure_reason] += 1
+
+    print("Frames not requested before their retry time, by claim failure reason:")
+    for (reason, name) in enumerate(physmem.CLAIM_FAILURE_NAMES):
+        if num_backing_off[reason]:
+            print("\t%-16s: %d frames (%02.1f %%)" % (name, num_backing_off[reason], (100.0 * num_backing_off[reason] / num_frames)))
+
 def reset_first_10_frames_in_config(path):
     """
     Reset the first 10 frames of the config
@@ -176,15 +226,89 @@ if __name__ == '__main__':
                            "[default: %default]")
 
     parser.add_option("-t", "--test-algorithm",dest="algorithm",type="choice",
-                      default="linear",choices=["linear","quadratic"],
-                      help="Algorithm used to verify frames: `linear`-time or `quadratic` runtime."
+                      default="linear",choices=["linear","quadratic","native","coverage"],
+                      help="Algorithm used to verify frames: `linear`-time or `quadratic` runtime. "
+                           "`native` is the linear algorithm in C (see --native-variant). "
+                           "`coverage` selects, per frame, the cheapest algorithm that covers the fault model "
+                           "that has been covered longest ago (only for the `blockwise` strategy)."
                            "[default: %default]")
 
+    parser.add_option("-n", "--native-variant",dest="native_variant",type="choice",
+                      default="non-temporal",choices=tester.native_linear.VARIANTS,
+                      help="How the `native` algorithm uses the caches: `temporal`, `clflush`, `non-temporal` or `streaming`. "
+                           "Build tester/native first. [default: %default]")
+
     parser.add_option("-f", "--report-frequency",dest="report_every",
                       default=50,type=int ,
                       help="Report performance statistics every REPORT_EVERY frames. `0` disables this report."
                            "[default: %default]")
 
+    parser.add_option("-i", "--interleave-map",dest="interleave_map",
+                      default="",
+                      metavar="MAP", help="Physical address interleave map used to order the frames of a block, "
+                           "e.g. `channel=7^14;bank=13^17,14^18` (see benchmark/micro/interleave_probe). "
+                           "Only used by the `blockwise` strategy. [default: PFN order]")
+
+    parser.add_option("-j", "--test-streams",dest="test_streams",
+                      default=1,type=int ,
+                      help="Number of frames of a block that are tested concurrently, by threads. Only supported by the `native` "
+                           "algorithm, which releases the GIL while testing; the Python algorithms would be serialised by the GIL. "
+                           "Only used by the `blockwise` strategy. [default: %default]")
+
+    parser.add_option("-p", "--fragmentation-aware",dest="fragmentation_aware",
+                      default=False, action="store_true",
+                      help="Test pageblock by pageblock, already split pageblocks first, to keep huge pages available. "
+                           "Only used by the `blockwise` strategy. [default: %default]")
+
+    parser.add_option("-v", "--verify-free",dest="verify_free",
+                      default=False, action="store_true",
+                      help="Before each run, let the module verify free memory by reading it (needs page poisoning, see the module's free_scan), "
+                           "and test the mismatching frames first. Only used by the `blockwise` strategy. [default: %default]")
+
+    parser.add_option("-r", "--predict-claims",dest="predict_claims",
+                      default=False, action="store_true",
+                      help="Assemble blocks from the frames with the best expected coverage per claim cost, "
+                           "predicted from the claim history of their region. Only used by the `blockwise` strategy. [default: %default]")
+
+    parser.add_option("-k", "--page-state",dest="page_state",type="choice",
+                      default="proc",choices=["proc","module"],
+                      help="Where the schedulers read the page flags and map counts from: `proc` (/proc/kpageflags, /proc/kpagecount) "
+                           "or `module` (the module's page state IOCTL: one consistent read per window of frames). [default: %default]")
+
+    parser.add_option("-d", "--dirty-page-cache",dest="dirty_page_cache",
+                      default=False, action="store_true",
+                      help="Also claim page-cache pages: dirty ones are written back first (see the module's dirty_writeback) "
+                           "and claimed when requested again. [default: %default]")
+
+    parser.add_option("-w", "--swap-cache",dest="swap_cache",
+                      default=False, action="store_true",
+                      help="Also claim unmapped swap-cache pages: clean ones are dropped from the swap cache, dirty ones are "
+                           "written to swap first (see the module's swap_cache). [default: %default]")
+
+    parser.add_option("-b", "--burn-in",dest="burn_in",
+                      default=False, action="store_true",
+                      help="Start with a burn-in sweep: one worker per CPU on all NUMA nodes, claiming in large extents, "
+                           "until all memory is swept or SIGUSR1 is received. Then continue in background mode with the frames "
+                           "the sweep has not tested. Only used by the `blockwise` strategy. [default: %default]")
+
+    parser.add_option("--burn-in-until",dest="burn_in_until",
+                      default=None, metavar="PATH",
+                      help="Also end the burn-in sweep as soon as PATH exists, e.g. a file created when the services are ready.")
+
+    parser.add_option("--burn-in-extent",dest="burn_in_extent",
+                      default=4096, type=int, metavar="FRAMES",
+                      help="Frames claimed at a time during the burn-in sweep. [default: %default]")
+
+    parser.add_option("--time-slice-us",dest="time_slice_us",
+                      default=0, type=int, metavar="US",
+                      help="Test the frames of a block interleaved in time slices of this length, instead of running each test "
+                           "to completion (replaces --test-streams). `0` disables slicing. Only used by the `blockwise` strategy. [default: %default]")
+
+    parser.add_option("--max-load",dest="max_load",
+                      default=None, type=float, metavar="LOAD",
+                      help="With --time-slice-us: abandon the unfinished tests of a block while more than LOAD tasks are runnable "
+                           "(procs_running in /proc/stat, averaged over 40 ms). The abandoned frames are tested in a later run. [default: never]")
+
     parser.add_option("-s", "--status_file",dest="status_file",
                       default='/tmp/memtest_status',
                       metavar="PATH", help="The path to the status file used by this program. The file will be created, if it does not exists. [default: %default]")
@@ -197,6 +321,44 @@ if __name__ == '__main__':
     if options.report_every < 0:
         parser.error("report-frequency must be > 0")
 
+    if options.test_streams < 1:
+        parser.error("test-streams must be > 0")
+
+    if options.test_streams > 1 and "native" != options.algorithm:
+        parser.error("--test-streams > 1 is only supported by the `native` algorithm")
+
+    if options.fragmentation_aware and "blockwise" != options.strategy:
+        parser.error("--fragmentation-aware is only supported by the `blockwise` strategy")
+
+    if options.verify_free and "blockwise" != options.strategy:
+        parser.error("--verify-free is only supported by the `blockwise` strategy")
+
+    if options.predict_claims and "blockwise" != options.strategy:
+        parser.error("--predict-claims is only supported by the `blockwise` strategy")
+
+    if options.burn_in and "blockwise" != options.strategy:
+        parser.error("--burn-in is only supported by the `blockwise` strategy")
+
+    if options.burn_in_extent < 1:
+        parser.error("burn-in-extent must be > 0")
+
+    if options.time_slice_us < 0:
+        parser.error("time-slice-us must be >= 0")
+
+    if options.time_slice_us and "blockwise" != options.strategy:
+        parser.error("--time-slice-us is only supported by the `blockwise` strategy")
+
+    if options.max_load is not None and not options.time_slice_us:
+        parser.error("--max-load needs --time-slice-us")
+
+    if "coverage" == options.algorithm and "blockwise" != options.strategy:
+        parser.error("The `coverage` test algorithm is only supported by the `blockwise` strategy")
+
+    try:
+        interleave_map = scheduling.interleave.parse_interleave_map(options.interleave_map)
+    except ValueError as e:
+        parser.error(str(e))
+
     path = options.status_file
  
     timestamping = status.TimestampingFacility()
@@ -213,39 +375,121 @@ if __name__ == '__main__':
         frame_config_class = scheduling.blockwise.get_frame_config_class()
 
     cfg = status.FileBasedConfiguration(path, num_frames, frame_config_class)
+    coverage_cfg = status.FileBasedConfiguration(path + ".coverage", num_frames, status.CoverageStatus)
+    backoff_cfg = status.FileBasedConfiguration(path + ".backoff", num_frames, status.BackoffStatus)
                 
     device_name = "/dev/phys_mem"
     physmem_dev  = physmem.Physmem(device_name)
     
     allowed_sources = physmem.SOURCE_FREE_BUDDY_PAGE
+    if options.dirty_page_cache:
+        allowed_sources |= physmem.SOURCE_DIRTY_PAGE_CACHE
+    if options.swap_cache:
+        allowed_sources |= physmem.SOURCE_SWAP_CACHE
+
+    if "module" == options.page_state:
+        # An own session: the page state IOCTL is not available while the frames are mapped
+        page_state = physmem.PageStateSource(physmem.Physmem(device_name))
+        pageflags = page_state.flags()
+        pagecount = page_state.counts()
 
 
+    selector = None
     if  "linear" == options.algorithm:
         test = tester.LinearScanner(PrintTestReporting())
     elif "quadratic" == options.algorithm:
         test = tester.QuadraticScanner(PrintTestReporting())
+    elif "native" == options.algorithm:
+        test = tester.NativeLinearScanner(PrintTestReporting(), options.native_variant)
+    elif "coverage" == options.algorithm:
+        # cheapest first
+        test = tester.LinearScanner(PrintTestReporting())
+        selector = scheduling.selection.OldestGapSelector([test, tester.QuadraticScanner(PrintTestReporting())])
 
 
     reporting = PrintSchedulerReporting(options.report_every)
+
+    pageblock_order = None
+    if options.fragmentation_aware:
+        pageblock_order = scheduling.fragmentation.PageblockOrder()
+
+    free_scan = None
+    if options.verify_free:
+        free_scan = scheduling.free_scan.FreeScan()
+
+    predictor = None
+    if options.predict_claims:
+        predictor = scheduling.prediction.ClaimPredictor()
+
+    slicer = None
+    if options.time_slice_us:
+        pressure = None
+        if options.max_load is not None:
+            pressure = scheduling.slicing.LoadPressure(options.max_load)
+        slicer = scheduling.slicing.TimeSlicer(options.time_slice_us / 1000000.0, pressure)
     
     if  "frame-by-frame" == options.strategy:
         scheduler_factory = scheduling.simple.SimpleSchedulerFactory(physmem_dev, test,  pageflags, pagecount, reporting)
     elif "blockwise" == options.strategy:
-        scheduler_factory =  scheduling.blockwise.SimpleBlockwiseSchedulerFactory(physmem_dev, test, pageflags, pagecount, timestamping, reporting)
-
-    print "Using the '%s' with a '%s' test algorithm" % (scheduler_factory.name(), test.name())
+        scheduler_factory =  scheduling.blockwise.SimpleBlockwiseSchedulerFactory(physmem_dev, test, pageflags, pagecount, timestamping, reporting, interleave_map, options.test_streams, selector, pageblock_order, free_scan, predictor, slicer)
+
+    print "Using the '%s' with a '%s' test algorithm" % (scheduler_factory.name(), (selector or test).name())
+
+    skip_tested_since = None
+    if options.burn_in:
+        def new_burn_in_scheduler(stop):
+            if "module" == options.page_state:
+                worker_page_state = physmem.PageStateSource(physmem.Physmem(device_name))
+                worker_flags = worker_page_state.flags()
+                worker_counts = worker_page_state.counts()
+            else:
+                worker_flags = kpage.FlagsDataSource('flags', "/proc/kpageflags").open()
+                worker_counts = kpage.CountDataSource('count', "/proc/kpagecount").open()
+
+            # Kept open for the lifetime of the worker process
+            return scheduler_factory.new_burn_in_instance(physmem.Physmem(device_name), worker_flags, worker_counts,
+                                                          cfg.open(), coverage_cfg.open(), backoff_cfg.open(), options.burn_in_extent, stop)
+
+        # Migrate and initialise the status files once, before the workers open them concurrently
+        for config in (cfg, coverage_cfg, backoff_cfg):
+            config.open().close()
+
+        skip_tested_since = timestamping.timestamp()
+        burn_in = scheduling.burn_in.BurnIn(new_burn_in_scheduler, num_frames, options.burn_in_until)
+        if burn_in.run(allowed_sources):
+            # Everything has been swept, the first background run starts over
+            skip_tested_since = None
 
     while True:
         with cfg.open() as s:
             print_stats(s,timestamping) 
+
+        if "blockwise" == options.strategy:
+            with coverage_cfg.open() as c:
+                print_coverage_stats(c, timestamping)
+            with backoff_cfg.open() as b:
+                print_backoff_stats(b, timestamping)
                 
         with cfg.open() as s:
-            reporting.reset()
-
-            scheduler = scheduler_factory.new_instance(s)
-            scheduler.run(0,num_frames, allowed_sources)
-            
-            reporting.print_stats()
+            with coverage_cfg.open() as c, backoff_cfg.open() as b:
+                reporting.reset()
+                buddyinfo_before = scheduling.fragmentation.read_buddyinfo()
+
+                if "blockwise" == options.strategy:
+                    scheduler = scheduler_factory.new_instance(s, c, b, skip_tested_since)
+                    # Only the first run continues the burn-in sweep
+                    skip_tested_since = None
+                else:
+                    scheduler = scheduler_factory.new_instance(s)
+                scheduler.run(0,num_frames, allowed_sources)
+
+                reporting.print_stats()
+                if predictor:
+                    predictor.print_stats()
+                if slicer:
+                    slicer.print_stats()
+                print("Free blocks (/proc/buddyinfo) before -> after this run:")
+                scheduling.fragmentation.print_buddyinfo_delta(buddyinfo_before, scheduling.fragmentation.read_buddyinfo())
         
     with cfg.open() as s:
         print_stats(s,timestamping) 
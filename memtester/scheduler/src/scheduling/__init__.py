@@ -23,4 +23,5 @@ THE SOFTWARE.
 '''
 import simple
 import blockwise
+import selection
 
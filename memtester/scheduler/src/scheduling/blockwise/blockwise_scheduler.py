@@ -24,13 +24,19 @@ THE SOFTWARE.
 
 import frame
 import physmem
+import threading
+
+from physmem import PAGE_SIZE
+from scheduling.interleave import InterleaveMap
+from scheduling.selection import FixedSelector
+from tester.resumable import ResumableTest
 
 
 def get_frame_config_class():
         return frame.FrameStatus
 
 class SimpleBlockwiseSchedulerFactory():
-    def __init__(self, physmem_device,frame_test,  kpageflags, kpagecount, timestamping, reporting):
+    def __init__(self, physmem_device,frame_test,  kpageflags, kpagecount, timestamping, reporting, interleave_map = None, test_streams = 1, selector = None, pageblock_order = None, free_scan = None, predictor = None, slicer = None):
         '''
         Constructor
         '''
@@ -42,9 +48,26 @@ class SimpleBlockwiseSchedulerFactory():
         self.max_untested_age = self.timestamping.seconds_to_timestamp( 60*60*24  )
         self.max_untested_age = 0
         self.reporting =  reporting
+        self.interleave_map = interleave_map
+        self.test_streams = test_streams
+        self.selector = selector
+        self.pageblock_order = pageblock_order
+        self.free_scan = free_scan
+        # Shared by all instances: it learns across runs
+        self.predictor = predictor
+        self.slicer = slicer
+
+    def new_instance(self, frame_stati, coverage_stati = None, backoff_stati = None, skip_tested_since = None):
+       return SimpleBlockwiseScheduler( self.physmem_device, self.frame_test, frame_stati, self.kpageflags, self.kpagecount, self.timestamping, self.reporting, self.interleave_map, self.test_streams, coverage_stati, self.selector, self.pageblock_order, self.free_scan, self.predictor, backoff_stati, skip_tested_since = skip_tested_since, slicer = self.slicer)
 
-    def new_instance(self, frame_stati):
-       return SimpleBlockwiseScheduler( self.physmem_device, self.frame_test, frame_stati, self.kpageflags, self.kpagecount, self.timestamping, self.reporting)
+    def new_burn_in_instance(self, physmem_device, kpageflags, kpagecount, frame_stati, coverage_stati, backoff_stati, extent_frames, stop = None):
+       """
+       A scheduler for a burn-in worker (scheduling.burn_in): its own device
+       session and kpage files, claims in extents of `extent_frames`, tests
+       one frame at a time (the workers are the parallelism) and sweeps in
+       PFN order. It returns as soon as `stop()` is true.
+       """
+       return SimpleBlockwiseScheduler( physmem_device, self.frame_test, frame_stati, kpageflags, kpagecount, self.timestamping, self.reporting, self.interleave_map, 1, coverage_stati, self.selector, None, None, None, backoff_stati, max_blocksize = extent_frames, stop = stop)
 
     def name(self):
         return "Blockwise Allocation Scheduler"
@@ -54,9 +77,43 @@ class SimpleBlockwiseScheduler(object):
     This scheduler iterates over all frames in the status and tests the frame, based on the evaluation function
     '''
 
-    def __init__(self, physmem_device,frame_test, frame_stati, kpageflags, kpagecount, timestamping, reporting):
+    def __init__(self, physmem_device,frame_test, frame_stati, kpageflags, kpagecount, timestamping, reporting, interleave_map = None, test_streams = 1, coverage_stati = None, selector = None, pageblock_order = None, free_scan = None, predictor = None, backoff_stati = None, max_blocksize = 100, skip_tested_since = None, slicer = None, stop = None):
         '''
         Constructor
+
+        interleave_map: a scheduling.interleave.InterleaveMap used to order the
+                        frames of a block. `None` keeps the PFN order.
+        test_streams:   number of frames tested concurrently. The streams are
+                        threads sharing one mapping: only use more than one
+                        with the native tester, which releases the GIL while
+                        its test kernel runs (the Python testers would be
+                        serialised by the GIL).
+        coverage_stati: the coverage ledger (status.CoverageStatus by pfn) or None
+        selector:       selects the test algorithm per frame (scheduling.selection).
+                        `None` always uses frame_test.
+        pageblock_order: a scheduling.fragmentation.PageblockOrder. Frames are
+                        tested pageblock by pageblock, split pageblocks first.
+                        `None` tests in PFN order.
+        free_scan:      a scheduling.free_scan.FreeScan. Free memory is verified
+                        by reading it first, and the suspects are tested
+                        before all other frames. `None` disables this.
+        predictor:      a scheduling.prediction.ClaimPredictor. Blocks are
+                        assembled from the candidates with the best expected
+                        coverage per claim cost. `None` keeps the PFN order.
+        backoff_stati:  the claim backoff (status.BackoffStatus by pfn) or None.
+                        Frames that could not be claimed are not requested
+                        again before the retry hint of the module has passed.
+        max_blocksize:  maximum number of frames claimed at a time
+        skip_tested_since: frames tested successfully since this timestamp
+                        are not tested, e.g. by a burn-in sweep. `None`
+                        tests all frames.
+        slicer:         a scheduling.slicing.TimeSlicer. The frames of a block
+                        are tested interleaved in time slices (instead of
+                        test_streams threads), unfinished tests are abandoned
+                        under pressure. `None` runs each test to completion.
+        stop:           called between blocks and batches; if it returns True,
+                        `run` returns and the untested frames are left for a
+                        later run. `None` never stops early.
         '''
         self.frame_stati = frame_stati
         self.kpageflags = kpageflags
@@ -67,13 +124,61 @@ class SimpleBlockwiseScheduler(object):
         self.max_untested_age = self.timestamping.seconds_to_timestamp( 60*60*24  )
         self.max_untested_age = 0
         self.reporting =  reporting
+        self.interleave_map = interleave_map or InterleaveMap()
+        self.test_streams = max(1, test_streams)
+        self.coverage_stati = coverage_stati
+        self.selector = selector or FixedSelector(frame_test)
+        self.pageblock_order = pageblock_order
+        self.free_scan = free_scan
+        self.predictor = predictor
+        self.backoff_stati = backoff_stati
+        self.max_blocksize = max_blocksize
+        self.skip_tested_since = skip_tested_since
+        self.slicer = slicer
+        self.stop = stop or (lambda: False)
 
     def name(self):
         return "Blockwise Allocation Scheduler"
         
     def run(self, first_frame,last_frame, allowed_sources):
-        
-        max_blocksize = 100
+        if self.free_scan:
+            self._run_suspects(first_frame, last_frame, allowed_sources)
+
+        if self.pageblock_order:
+            ranges = self.pageblock_order.order(first_frame, last_frame)
+        else:
+            ranges = [(first_frame, last_frame)]
+
+        # A block never spans two ranges
+        for (first, last) in ranges:
+            if self.stop():
+                return
+            self._run_range(first, last, allowed_sources)
+
+    def _run_suspects(self, first_frame, last_frame, allowed_sources):
+        """
+        Claim and test the frames that failed the read-only verification,
+        independent of their last test.
+        """
+        suspects = [pfn for pfn in self.free_scan.scan(last_frame) if first_frame <= pfn < last_frame]
+        if not suspects:
+            return
+
+        print("%d free frames do not hold the free page pattern, testing them first" % (len(suspects),))
+
+        max_blocksize = self.max_blocksize
+        for i in xrange(0, len(suspects), max_blocksize):
+            if self.stop():
+                return
+            block = [self._pfn_status(pfn) for pfn in suspects[i:i + max_blocksize]]
+            self.test_frames_and_record_result(block, allowed_sources)
+
+    def _run_range(self, first_frame,last_frame, allowed_sources):
+        if self.predictor:
+            self._run_range_predicted(first_frame, last_frame, allowed_sources)
+            return
+
+        max_blocksize = self.max_blocksize
         max_non_matching = 100
         
         cur_non_matching = 0
@@ -91,23 +196,61 @@ class SimpleBlockwiseScheduler(object):
                 
             if (len(block) == max_blocksize ) or (cur_non_matching >= max_non_matching): 
                 if (len(block) > 0 ):   
+                    if self.stop():
+                        return
                     self.test_frames_and_record_result(block, allowed_sources)
                     block = []
                 cur_non_matching = 0
 
-        if (len(block) > 0  ):
+        if (len(block) > 0  ) and not self.stop():
                 self.test_frames_and_record_result(block, allowed_sources)
                 
                 
             
+    def _run_range_predicted(self, first_frame, last_frame, allowed_sources):
+        """
+        Rank the candidates of a window of frames by the predictor and test
+        them in blocks, best first. The window bounds the number of status
+        objects held at a time.
+        """
+        max_blocksize = self.max_blocksize
+        window = 10 * max_blocksize
+
+        for window_start in xrange(first_frame, last_frame, window):
+            candidates = []
+            for pfn in xrange(window_start, min(last_frame, window_start + window)):
+                frame_status = self._pfn_status(pfn)
+                if self.should_test(frame_status):
+                    candidates.append(frame_status)
+
+            now = self.timestamping.timestamp_to_seconds(self.timestamping.timestamp())
+            ranked = self.predictor.rank(candidates, now, self.timestamping.timestamp_to_seconds)
+
+            for i in xrange(0, len(ranked), max_blocksize):
+                if self.stop():
+                    return
+                self.test_frames_and_record_result(ranked[i:i + max_blocksize], allowed_sources)
+
     def  should_test(self,frame_status):
         now = self.timestamping.timestamp()
         time_untested = now - frame_status.last_successfull_test
+
+        backoff_status = self._backoff_status(frame_status.pfn)
+        if backoff_status and backoff_status.is_backing_off(now):
+            return False
+
+        if self.skip_tested_since and frame_status.last_successfull_test >= self.skip_tested_since:
+            return False
         
         return  (time_untested > self.max_untested_age )
 
     def  test_frames_and_record_result(self,frame_stati, allowed_sources):
         
+        # The VMA maps the claimed frames in request order. Ordering the
+        # request by the interleave map makes neighbouring frames (and the
+        # frames of a batch) hit different channels/banks.
+        frame_stati = self.interleave_map.order(frame_stati)
+
         pfns = [frame_status.pfn for  frame_status in frame_stati]
         
         status_by_pfn = dict([ (frame_status.pfn, frame_status) for  frame_status in frame_stati])
@@ -115,39 +258,143 @@ class SimpleBlockwiseScheduler(object):
         results = self._claim_pfns(pfns, allowed_sources)
 
         num_frames_claimed = 0
+        claimed = []
         
         for frame in results:
             if  frame.pfn in status_by_pfn:
                 if frame.is_claimed():    
                     num_frames_claimed += 1
+                    claimed.append(frame)
                     
         for frame in results:
-            if  frame.pfn in status_by_pfn:
-                frame_status = status_by_pfn[frame.pfn]
+            requested_pfn = frame.request.requested_pfn
+            if  requested_pfn in status_by_pfn:
+                frame_status = status_by_pfn[requested_pfn]
+                if self.predictor:
+                    self.predictor.update(frame_status, frame.is_claimed(), frame.allocation_cost_jiffies)
+
                 frame_status.last_claiming_attempt =  self.timestamping.timestamp()
-                    
-                if frame.is_claimed():
-                    frame_status.last_claiming_time_jiffies = frame.allocation_cost_jiffies
-                    frame_status.last_successfull_claiming_method = frame.actual_source
-                    
-                    is_ok = False
-                    
-                    with self.physmem_device.mmap(physmem.PAGE_SIZE * num_frames_claimed) as map:
-                        # It is better to handle bad frames after they are unmapped
-                        is_ok = self.frame_test.test(map,frame.vma_offset_of_first_byte  ,physmem.PAGE_SIZE)
-        
-                    if is_ok:
-                        frame_status.has_errors = 0
-                        frame_status.last_successfull_test = self.timestamping.timestamp() 
-                        self._report_good_frame(frame.pfn)         
+
+                backoff_status = self._backoff_status(requested_pfn)
+                if backoff_status:
+                    if frame.is_claimed():
+                        backoff_status.record_success()
                     else:
-                        frame_status.num_errors += 1
-                        self.physmem_device.mark_pfn_bad(frame.pfn)
-                        self._report_bad_frame(frame.pfn)         
-                               
-            else:
+                        backoff_status.record_failure(frame.failure_reason, frame.retry_after_ms, frame_status.last_claiming_attempt, self.timestamping)
+
+            if not frame.is_claimed():
                 # Hmm, better luck next time
-                self._report_not_aquired_frame(frame_status.pfn)
+                self._report_not_aquired_frame(requested_pfn)
+
+        if num_frames_claimed == 0:
+            return
+
+        for batch in self._batches(claimed):
+            if self.stop():
+                # The remaining claimed frames are released untested by the next claim
+                break
+            result_by_pfn = self._test_batch(batch, PAGE_SIZE * num_frames_claimed)
+
+            # It is better to handle bad frames after they are unmapped
+            for frame in batch:
+                frame_status = status_by_pfn[frame.pfn]
+                frame_status.last_claiming_time_jiffies = frame.allocation_cost_jiffies
+                frame_status.last_successfull_claiming_method = frame.actual_source
+
+                if not frame.pfn in result_by_pfn:
+                    # Abandoned under pressure, tested in a later run
+                    continue
+
+                (is_ok, frame_test) = result_by_pfn[frame.pfn]
+                coverage_status = self._coverage_status(frame.pfn)
+
+                if is_ok:
+                    frame_status.has_errors = 0
+                    frame_status.last_successfull_test = self.timestamping.timestamp() 
+                    if coverage_status:
+                        coverage_status.record(frame_test.FAULT_MODELS, self.timestamping.timestamp_to_seconds(frame_status.last_successfull_test))
+                    self._report_good_frame(frame.pfn)         
+                else:
+                    frame_status.num_errors += 1
+                    if coverage_status:
+                        coverage_status.reset(frame_test.FAULT_MODELS)
+                    self.physmem_device.mark_pfn_bad(frame.pfn)
+                    self._report_bad_frame(frame.pfn)         
+
+    def _batches(self, claimed):
+        """
+        `claimed` is already in interleave order, so slicing it keeps the
+        frames of a batch on different channels. With a slicer all frames
+        are one batch: they are interleaved by slices instead of threads.
+        """
+        if self.slicer:
+            return [claimed]
+
+        streams = self.test_streams
+        return [claimed[i:i + streams] for i in xrange(0, len(claimed), streams)]
+
+    def _test_batch(self, batch, map_length):
+        """
+        Test all frames in batch, one test stream per frame. All streams
+        share one mapping of the session: the native tester addresses it by
+        its virtual address, not through the file position of the mapping.
+
+        Returns { pfn : (is_ok, frame_test) }
+        """
+        if self.slicer:
+            return self._test_batch_sliced(batch, map_length)
+
+        result_by_pfn = {}
+
+        with self.physmem_device.mmap(map_length) as map:
+            def test_frame(frame):
+                frame_test = self.selector.select(self._coverage_status(frame.pfn))
+                is_ok = frame_test.test(map, frame.vma_offset_of_first_byte, PAGE_SIZE)
+                result_by_pfn[frame.pfn] = (is_ok, frame_test)
+
+            if len(batch) == 1:
+                test_frame(batch[0])
+            else:
+                streams = [threading.Thread(target=test_frame, args=(frame,)) for frame in batch]
+                for stream in streams:
+                    stream.start()
+                for stream in streams:
+                    stream.join()
+
+        return result_by_pfn
+
+    def _test_batch_sliced(self, batch, map_length):
+        """
+        Test all frames in batch interleaved in time slices. Frames whose
+        test has been abandoned are missing in the result. Like
+        _test_batch(), all tests share one mapping of the session.
+
+        Returns { pfn : (is_ok, frame_test) }
+        """
+        with self.physmem_device.mmap(map_length) as map:
+            tests = []
+            for frame in batch:
+                frame_test = self.selector.select(self._coverage_status(frame.pfn))
+                steps = frame_test.steps(map, frame.vma_offset_of_first_byte, PAGE_SIZE)
+                tests.append((frame, frame_test, ResumableTest(steps)))
+
+            self.slicer.run([test for (frame, frame_test, test) in tests])
+
+        result_by_pfn = {}
+        for (frame, frame_test, test) in tests:
+            if test.is_done and test.is_ok is not None:
+                result_by_pfn[frame.pfn] = (test.is_ok, frame_test)
+        return result_by_pfn
+
+    def _coverage_status(self, pfn):
+        if self.coverage_stati:
+            return self.coverage_stati[pfn]
+        return None
+
+    def _backoff_status(self, pfn):
+        if self.backoff_stati:
+            return self.backoff_stati[pfn]
+        return None
 
     def _report_not_aquired_frame(self, pfn):
         pass
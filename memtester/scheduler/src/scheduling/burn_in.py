@@ -0,0 +1,257 @@
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+"""
+ Burn-in: sweep all claimable memory as fast as possible.
+
+ Right after boot most memory is free and nothing is sensitive to
+ interference. The burn-in sweep runs one worker process per CPU, each pinned
+ to the CPUs of its NUMA node and sweeping a share of the node's memory,
+ and claims in extents of thousands of frames instead of blocks of 100.
+
+ The sweep ends when all memory has been swept, on SIGUSR1, or when a
+ readiness file appears (e.g. created by the last service to start). The
+ progress is kept in the status file: frames tested by the sweep are skipped
+ by the first background run.
+"""
+
+import ctypes
+import multiprocessing
+import os
+import re
+import signal
+import time
+
+NODE_PATH = "/sys/devices/system/node"
+MEMORY_PATH = "/sys/devices/system/memory"
+
+PAGE_SIZE = 4096
+
+
+def parse_cpulist(cpulist):
+    """
+    "0-3,8,10-11" -> [0, 1, 2, 3, 8, 10, 11]
+    """
+    cpus = []
+    for item in cpulist.strip().split(","):
+        if not item:
+            continue
+        if "-" in item:
+            (first, last) = item.split("-")
+            cpus.extend(range(int(first), int(last) + 1))
+        else:
+            cpus.append(int(item))
+    return cpus
+
+
+def _merge_ranges(ranges):
+    merged = []
+    for (first, last) in sorted(ranges):
+        if merged and merged[-1][1] == first:
+            merged[-1] = (merged[-1][0], last)
+        else:
+            merged.append((first, last))
+    return merged
+
+
+def numa_nodes(num_frames, node_path = NODE_PATH, memory_path = MEMORY_PATH):
+    """
+    Returns [(node, [cpu, ..], [(first_pfn, last_pfn), ..]), ..], pfn ranges
+    are half open and limited to num_frames. Without NUMA information all
+    CPUs and all frames form node 0.
+    """
+    nodes = []
+    try:
+        with open(os.path.join(memory_path, "block_size_bytes")) as f:
+            block_frames = int(f.read(), 16) / PAGE_SIZE
+
+        for name in sorted(os.listdir(node_path)):
+            match = re.match(r'^node(\d+)$', name)
+            if not match:
+                continue
+
+            with open(os.path.join(node_path, name, "cpulist")) as f:
+                cpus = parse_cpulist(f.read())
+
+            ranges = []
+            for entry in os.listdir(os.path.join(node_path, name)):
+                block = re.match(r'^memory(\d+)$', entry)
+                if block:
+                    first = int(block.group(1)) * block_frames
+                    if first < num_frames:
+                        ranges.append((first, min(num_frames, first + block_frames)))
+
+            if ranges:
+                nodes.append((int(match.group(1)), cpus, _merge_ranges(ranges)))
+    except (IOError, OSError, ValueError):
+        nodes = []
+
+    if not nodes:
+        nodes = [(0, range(multiprocessing.cpu_count()), [(0, num_frames)])]
+
+    return nodes
+
+
+def split_ranges(ranges, parts):
+    """
+    Split the pfn ranges into `parts` shares of about the same number of frames
+    """
+    total = sum([last - first for (first, last) in ranges])
+    share = max(1, (total + parts - 1) / parts)
+
+    shares = [[]]
+    left = share
+    for (first, last) in ranges:
+        while first < last:
+            if not left:
+                shares.append([])
+                left = share
+            step = min(left, last - first)
+            shares[-1].append((first, first + step))
+            first += step
+            left -= step
+    return shares
+
+
+_libc = None
+
+def pin_to_cpus(cpus):
+    """
+    sched_setaffinity(2) for the calling process (Python 2 has no os.sched_setaffinity)
+    """
+    global _libc
+    if not cpus:
+        return
+
+    if not _libc:
+        _libc = ctypes.CDLL(None, use_errno = True)
+
+    mask = (ctypes.c_ulong * (max(cpus) / (8 * ctypes.sizeof(ctypes.c_ulong)) + 1))()
+    bits = 8 * ctypes.sizeof(ctypes.c_ulong)
+    for cpu in cpus:
+        mask[cpu / bits] |= 1 << (cpu % bits)
+
+    if _libc.sched_setaffinity(0, ctypes.sizeof(mask), ctypes.byref(mask)):
+        print("Could not pin the burn-in worker to the cpus %s" % (cpus,))
+
+
+def _worker(new_scheduler, cpus, ranges, slice_frames, allowed_sources, stop, progress):
+    # The parent decides when to stop
+    signal.signal(signal.SIGUSR1, signal.SIG_IGN)
+    pin_to_cpus(cpus)
+
+    # Own device session, own kpage files and status mappings. The scheduler
+    # checks `stop` between its blocks, so that a slice ends promptly.
+    scheduler = new_scheduler(stop.is_set)
+
+    for (first, last) in ranges:
+        for slice_start in xrange(first, last, slice_frames):
+            if stop.is_set():
+                return
+            slice_end = min(last, slice_start + slice_frames)
+            scheduler.run(slice_start, slice_end, allowed_sources)
+            if stop.is_set():
+                # The slice may be incomplete
+                return
+            with progress.get_lock():
+                progress.value += slice_end - slice_start
+
+
+class BurnIn(object):
+    '''
+    Runs the burn-in sweep over pfn 0..num_frames-1.
+    '''
+
+    def __init__(self, new_scheduler, num_frames, until_path = None, workers_per_node = None, slice_frames = 1 << 16, report_every = 10):
+        '''
+        new_scheduler:    called in each worker process with a `stop()`
+                          callable, returns the scheduler used by the
+                          worker. It must open its own device session and
+                          kpage files, and return between blocks as soon as
+                          `stop()` is true.
+        until_path:       end the sweep as soon as this path exists
+        workers_per_node: `None`: one worker per CPU of the node
+        slice_frames:     frames passed to the scheduler at a time
+        report_every:     seconds between two progress lines
+        '''
+        self.new_scheduler = new_scheduler
+        self.num_frames = num_frames
+        self.until_path = until_path
+        self.workers_per_node = workers_per_node
+        self.slice_frames = slice_frames
+        self.report_every = report_every
+        self.signalled = False
+
+    def _on_signal(self, signum, frame):
+        self.signalled = True
+
+    def _should_end(self):
+        return self.signalled or (self.until_path and os.path.exists(self.until_path))
+
+    def run(self, allowed_sources):
+        """
+        Sweep until done or told to end. Returns True if all memory has been
+        swept.
+        """
+        stop = multiprocessing.Event()
+        progress = multiprocessing.Value(ctypes.c_ulong, 0)
+
+        workers = []
+        total_frames = 0
+        for (node, cpus, ranges) in numa_nodes(self.num_frames):
+            total_frames += sum([last - first for (first, last) in ranges])
+            num_workers = self.workers_per_node or max(1, len(cpus))
+            for share in split_ranges(ranges, num_workers):
+                workers.append(multiprocessing.Process(target = _worker, args = (self.new_scheduler, cpus, share, self.slice_frames, allowed_sources, stop, progress)))
+
+        previous_handler = signal.signal(signal.SIGUSR1, self._on_signal)
+        start = time.time()
+        last_report = start
+        try:
+            print("Burn-in: sweeping %d frames with %d workers (SIGUSR1%s ends the sweep)" % (total_frames, len(workers), (" or " + self.until_path) if self.until_path else ""))
+            for worker in workers:
+                worker.start()
+
+            while [worker for worker in workers if worker.is_alive()]:
+                if self._should_end() and not stop.is_set():
+                    print("Burn-in: switching to background mode")
+                    stop.set()
+
+                now = time.time()
+                if now - last_report >= self.report_every:
+                    last_report = now
+                    self._report(progress.value, total_frames, now - start)
+
+                time.sleep(0.5)
+        finally:
+            stop.set()
+            for worker in workers:
+                worker.join()
+            signal.signal(signal.SIGUSR1, previous_handler)
+
+        self._report(progress.value, total_frames, time.time() - start)
+        return progress.value >= total_frames
+
+    def _report(self, frames_swept, total_frames, seconds):
+        print("Burn-in: %d of %d frames swept (%02.1f %%) in %d s, %.1f MB/s" % (frames_swept, total_frames, (100.0 * frames_swept / max(1, total_frames)),
+                                                                          seconds, frames_swept * PAGE_SIZE / max(seconds, 0.001) / (1024 * 1024)))
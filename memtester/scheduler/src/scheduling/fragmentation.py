@@ -0,0 +1,127 @@
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+
+"""
+ Fragmentation-aware ordering of the frames to test.
+
+ Claiming a frame out of a free high-order block splits that block (or, with
+ the module's whole-block claiming, holds all of it) for as long as the frame
+ is tested. To keep huge pages available, the scheduler
+
+   - tests pageblocks that are already split (partially allocated) before
+     pageblocks that are entirely free, and
+   - tests one pageblock at a time, so that the claims held at any moment
+     are packed into as few pageblocks as possible.
+
+ /proc/kpageflags does not export the order of a free block. A pageblock is
+ considered entirely free if its first frame is a free buddy block head and
+ every other frame has either no flags (the tail frames of a free block on
+ older kernels) or only BUDDY set (newer kernels flag every frame of a free
+ block).
+"""
+
+import struct
+
+import kpage
+
+PAGEBLOCK_ORDER = 9
+
+BUDDYINFO_PATH = "/proc/buddyinfo"
+
+
+class PageblockOrder(object):
+    '''
+    Orders the pageblocks of a pfn range: split pageblocks first.
+    '''
+
+    def __init__(self, kpageflags_path = "/proc/kpageflags", pageblock_order = PAGEBLOCK_ORDER):
+        self.kpageflags_path = kpageflags_path
+        self.pageblock_nr_pages = 1 << pageblock_order
+
+    def _is_entirely_free(self, flags):
+        if not flags or not (flags[0] & kpage.kpageflags.BUDDY):
+            return False
+        for f in flags[1:]:
+            if f and f != kpage.kpageflags.BUDDY:
+                return False
+        return True
+
+    def order(self, first_frame, last_frame):
+        """
+        Returns the list of pfn ranges [(first, last), ..] (last exclusive)
+        covering first_frame..last_frame-1, one range per pageblock. Split
+        pageblocks come first, entirely free pageblocks last, each group in
+        pfn order.
+        """
+        split = []
+        free = []
+
+        with open(self.kpageflags_path, 'rb') as f:
+            start = first_frame
+            while start < last_frame:
+                # Ranges are aligned to pageblocks
+                end = min(last_frame, (start // self.pageblock_nr_pages + 1) * self.pageblock_nr_pages)
+
+                f.seek(start * 8)
+                chunk = f.read((end - start) * 8)
+                flags = struct.unpack("%dQ" % (len(chunk) // 8,), chunk)
+
+                if (end - start) == self.pageblock_nr_pages and self._is_entirely_free(flags):
+                    free.append((start, end))
+                else:
+                    split.append((start, end))
+                start = end
+
+        return split + free
+
+
+def read_buddyinfo(path = BUDDYINFO_PATH):
+    """
+    Returns { "Node N, zone Z" : [free blocks of order 0, 1, ..] }
+    """
+    ret = {}
+    with open(path, 'r') as f:
+        for line in f:
+            # Node 0, zone   Normal    100     50 ...
+            (zone, counts) = line.split("zone", 1)
+            fields = counts.split()
+            key = "%s zone %s" % (zone.strip(), fields[0])
+            ret[key] = [int(count) for count in fields[1:]]
+    return ret
+
+
+def print_buddyinfo_delta(before, after, min_order = PAGEBLOCK_ORDER):
+    """
+    Print the free blocks per order before and after a run, and the number of
+    free blocks of order >= min_order (i.e. the huge page availability).
+    """
+    for key in sorted(after.keys()):
+        counts_after = after[key]
+        counts_before = before.get(key, [0] * len(counts_after))
+
+        high_before = sum(counts_before[min_order:])
+        high_after = sum(counts_after[min_order:])
+
+        print("\t%-24s order>=%d: %d -> %d (%+d)" % (key, min_order, high_before, high_after, high_after - high_before))
+        print("\t%-24s per order: %s" % ("", " ".join(["%d->%d" % (b, a) for (b, a) in zip(counts_before, counts_after)])))
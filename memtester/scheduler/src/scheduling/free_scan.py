@@ -0,0 +1,88 @@
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+
+"""
+ Read-only verification of free memory by the phys_mem module.
+
+ With page poisoning the kernel fills every free page with a known pattern,
+ so the module can verify free memory by reading it, without claiming it
+ (see physmem/kernel/module/include/free_scan.h). Frames whose content does
+ not match are suspects: the scheduler claims and tests them first.
+"""
+
+import time
+
+FREE_SCAN_PATH = "/sys/kernel/debug/phys_mem/free_scan"
+
+
+class FreeScan(object):
+    '''
+    Drives the free_scan debugfs file of the module.
+    '''
+
+    def __init__(self, path = FREE_SCAN_PATH, step_pfns = 1 << 16, pause = 0.01):
+        '''
+        step_pfns: pfns verified per step. The module does not yield between
+                   the blocks of a step to user space.
+        pause:     seconds to sleep between two steps
+        '''
+        self.path = path
+        self.step_pfns = step_pfns
+        self.pause = pause
+
+    def _write(self, value):
+        with open(self.path, 'w') as f:
+            f.write("%d\n" % (value,))
+
+    def scan(self, num_frames):
+        """
+        Verify the free frames among pfn 0..num_frames-1. Returns the list of
+        suspect pfns, sorted.
+
+        Raises IOError if the module cannot verify free memory (not loaded,
+        no debugfs, or the kernel does not poison free pages).
+        """
+        self._write(0)
+
+        done = 0
+        while done < num_frames:
+            step = min(self.step_pfns, num_frames - done)
+            self._write(step)
+            done += step
+            if self.pause:
+                time.sleep(self.pause)
+
+        return sorted(set(self.suspects()))
+
+    def suspects(self):
+        """
+        The suspects recorded since the last scan() started
+        """
+        ret = []
+        with open(self.path, 'r') as f:
+            for line in f:
+                # suspect 0x1234
+                if line.startswith("suspect "):
+                    ret.append(int(line.split()[1], 16))
+        return ret
@@ -0,0 +1,183 @@
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+
+"""
+ Physical address interleaving of the memory controller.
+
+ Memory controllers spread physical addresses over channels, ranks and banks.
+ Each of these is selected by a function of the physical address, typically
+ the XOR of a few address bits. A map is written as
+
+    channel=7^14,8^15;rank=16;bank=13^17,14^18
+
+ i.e. a `;`-separated list of `kind=functions`, where each function is a
+ `^`-separated list of physical address bits. Functions that only use bits
+ below PAGE_SHIFT interleave *inside* a frame and do not affect the ordering
+ of frames, so only bits >= PAGE_SHIFT are evaluated.
+
+ `benchmark/micro/interleave_probe.c` can be used to find the functions of a
+ machine.
+"""
+
+PAGE_SHIFT = 12
+
+KINDS = ["channel", "rank", "bank"]
+
+
+def _parity(value):
+    parity = 0
+    while value:
+        parity ^= 1
+        value &= value - 1
+    return parity
+
+
+class InterleaveMap(object):
+    '''
+    Maps a pfn to the (channel, rank, bank) it is located on.
+    '''
+
+    def __init__(self, functions_by_kind = None):
+        '''
+        functions_by_kind: { kind : [ [bit, bit, ..], ..] }
+        '''
+        self.masks = {}
+        for kind in KINDS:
+            self.masks[kind] = []
+
+        if functions_by_kind:
+            for (kind, functions) in functions_by_kind.iteritems():
+                if not kind in KINDS:
+                    raise ValueError("Unknown interleave kind '%s', expected one of %s" % (kind, KINDS))
+                for bits in functions:
+                    self._add_function(kind, bits)
+
+    def _add_function(self, kind, bits):
+        mask = 0
+        for bit in bits:
+            if bit >= PAGE_SHIFT:
+                mask |= 1 << (bit - PAGE_SHIFT)
+        if mask:
+            self.masks[kind].append(mask)
+
+    def is_empty(self):
+        for kind in KINDS:
+            if self.masks[kind]:
+                return False
+        return True
+
+    def _index(self, kind, pfn):
+        index = 0
+        for mask in self.masks[kind]:
+            index = (index << 1) | _parity(pfn & mask)
+        return index
+
+    def unit_of(self, pfn):
+        """
+        Returns (channel, rank, bank) of the frame
+        """
+        return tuple([self._index(kind, pfn) for kind in KINDS])
+
+    def order(self, frame_stati):
+        """
+        Reorder frame_stati (anything with a `pfn` attribute) so that
+        consecutive frames are located on different channels, and, within a
+        channel, on different ranks/banks.
+
+        Frames are dealt round-robin from one bucket per unit. The relative
+        (PFN) order within each bucket is kept.
+        """
+        if self.is_empty() or len(frame_stati) < 2:
+            return list(frame_stati)
+
+        buckets = {}
+        for frame_status in frame_stati:
+            unit = self.unit_of(frame_status.pfn)
+            if buckets.has_key(unit):
+                buckets[unit].append(frame_status)
+            else:
+                buckets[unit] = [frame_status]
+
+        # Interleave the keys by channel first: sort by (rank, bank) and
+        # deal the channels round-robin, so that two neighbouring keys never
+        # share a channel if it can be avoided.
+        by_channel = {}
+        for unit in sorted(buckets.keys()):
+            channel = unit[0]
+            if by_channel.has_key(channel):
+                by_channel[channel].append(unit)
+            else:
+                by_channel[channel] = [unit]
+        units = _round_robin([by_channel[c] for c in sorted(by_channel.keys())])
+
+        return _round_robin([buckets[unit] for unit in units])
+
+    def __str__(self):
+        parts = []
+        for kind in KINDS:
+            if self.masks[kind]:
+                functions = []
+                for mask in self.masks[kind]:
+                    bits = [str(bit + PAGE_SHIFT) for bit in xrange(0, 64) if mask & (1 << bit)]
+                    functions.append("^".join(bits))
+                parts.append("%s=%s" % (kind, ",".join(functions)))
+        return ";".join(parts)
+
+
+def _round_robin(lists):
+    ret = []
+    iterators = [iter(l) for l in lists]
+    while iterators:
+        alive = []
+        for it in iterators:
+            try:
+                ret.append(it.next())
+                alive.append(it)
+            except StopIteration:
+                pass
+        iterators = alive
+    return ret
+
+
+def parse_interleave_map(spec):
+    """
+    Parse a map in the format described at the top of the module. An empty
+    spec returns an empty map (i.e. frames are left in PFN order).
+    """
+    functions_by_kind = {}
+    if spec:
+        for part in spec.split(";"):
+            part = part.strip()
+            if not part:
+                continue
+            if not "=" in part:
+                raise ValueError("Invalid interleave map part '%s': expected KIND=FUNCTIONS" % (part,))
+            (kind, functions) = part.split("=", 1)
+            kind = kind.strip()
+            parsed = functions_by_kind.setdefault(kind, [])
+            for function in functions.split(","):
+                bits = [int(bit) for bit in function.split("^") if bit.strip()]
+                if bits:
+                    parsed.append(bits)
+    return InterleaveMap(functions_by_kind)
@@ -0,0 +1,197 @@
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+
+"""
+ Predicts the success and the cost of claiming a frame.
+
+ Whether the module can claim a frame, and how long it takes, depends on
+ what the frame is used for (its flags decide which claimer is responsible)
+ and on its neighbourhood (a region full of kernel allocations rarely
+ yields a frame). The predictor keeps, per region of 2^region_order frames
+ and per usage class of the flags, an exponentially weighted moving
+ average (EWMA) of
+
+   - the claim success (1: claimed, 0: not claimed), and
+   - the claim cost in jiffies (only for claimed frames).
+
+ The estimates are kept in one flat array per usage class, indexed by
+ region (8 bytes per region and class), so the predictor stays small on
+ large hosts. It is updated online with every claim result. Regions without history
+ fall back to the frame's own history in the status store
+ (last_successfull_claiming_method, last_claiming_attempt,
+ last_claiming_time_jiffies), and then to a per-class default.
+
+ Candidates are ranked by the expected coverage gained per claim cost:
+
+   score = P(claimed) * (seconds since the last successful test + 1) / (expected cost + 1)
+"""
+
+import random
+from array import array
+
+import kpage
+
+# Usage classes of the flags: they decide which claimer gets the frame
+CLASS_FREE = 0          # free buddy page
+CLASS_PAGE_CACHE = 1    # on the LRU, not anonymous
+CLASS_ANON = 2          # anonymous memory
+CLASS_OTHER = 3         # kernel allocations, reserved frames, ...
+
+CLASS_NAMES = ["free", "page cache", "anon", "other"]
+
+# P(claimed) of a class without any history
+DEFAULT_PROBABILITY = [0.9, 0.5, 0.3, 0.05]
+
+# P(claimed) of a region without history in the estimate arrays
+NO_HISTORY = -1.0
+
+
+def usage_class(flags):
+    """
+    flags: kpage.KPageFlags or None
+    """
+    if flags is None:
+        return CLASS_OTHER
+    if flags.any_set_in(kpage.kpageflags.BUDDY):
+        return CLASS_FREE
+    if flags.any_set_in(kpage.kpageflags.ANON):
+        return CLASS_ANON
+    if flags.any_set_in(kpage.kpageflags.LRU):
+        return CLASS_PAGE_CACHE
+    return CLASS_OTHER
+
+
+class ClaimPredictor(object):
+    '''
+    Per region and usage class EWMA of the claim success and cost.
+    '''
+
+    def __init__(self, region_order = 9, alpha = 0.25, min_probability = 0.05):
+        '''
+        region_order:    a region has 2^region_order frames (default: a pageblock)
+        alpha:           weight of a new observation
+        min_probability: candidates below this are only tested now and then
+                         (proportional to their probability), so that the
+                         prediction can recover
+        '''
+        self.region_order = region_order
+        self.alpha = alpha
+        self.min_probability = min_probability
+
+        # Per class, indexed by region: P(claimed) (NO_HISTORY if unknown) and cost in jiffies
+        self.probabilities = [array('f') for klass in CLASS_NAMES]
+        self.costs = [array('f') for klass in CLASS_NAMES]
+
+        self.num_updates = 0
+        self.num_skipped = 0
+
+    def _key(self, pfn, flags):
+        return (pfn >> self.region_order, usage_class(flags))
+
+    def _estimate(self, key):
+        """
+        [P(claimed), cost] of the region and class, None without history
+        """
+        (region, klass) = key
+        probabilities = self.probabilities[klass]
+        if region >= len(probabilities) or probabilities[region] == NO_HISTORY:
+            return None
+        return [probabilities[region], self.costs[klass][region]]
+
+    def _store(self, key, estimate):
+        (region, klass) = key
+        probabilities = self.probabilities[klass]
+        if region >= len(probabilities):
+            # Grow at least by half, so that a sweep up the pfns does not copy quadratically
+            missing = max(region + 1, len(probabilities) * 3 / 2) - len(probabilities)
+            probabilities.extend(array('f', [NO_HISTORY]) * missing)
+            self.costs[klass].extend(array('f', [0.0]) * missing)
+
+        probabilities[region] = estimate[0]
+        self.costs[klass][region] = estimate[1]
+
+    def _prior(self, frame_status, klass):
+        if frame_status.last_successfull_claiming_method:
+            return [max(DEFAULT_PROBABILITY[klass], 0.5), float(frame_status.last_claiming_time_jiffies)]
+        if frame_status.last_claiming_attempt:
+            # Attempted, never claimed
+            return [DEFAULT_PROBABILITY[klass] / 2, 0.0]
+        return [DEFAULT_PROBABILITY[klass], 0.0]
+
+    def predict(self, frame_status):
+        """
+        Returns (P(claimed), expected cost in jiffies) for the frame.
+        frame_status.pfn and .flags must be set.
+        """
+        key = self._key(frame_status.pfn, frame_status.flags)
+        estimate = self._estimate(key)
+        if estimate is None:
+            estimate = self._prior(frame_status, key[1])
+        return (estimate[0], estimate[1])
+
+    def update(self, frame_status, claimed, cost_jiffies):
+        """
+        Record the result of a claim attempt
+        """
+        key = self._key(frame_status.pfn, frame_status.flags)
+        estimate = self._estimate(key)
+        if estimate is None:
+            estimate = self._prior(frame_status, key[1])
+
+        estimate[0] += self.alpha * ((claimed and 1.0 or 0.0) - estimate[0])
+        if claimed:
+            estimate[1] += self.alpha * (cost_jiffies - estimate[1])
+        self._store(key, estimate)
+        self.num_updates += 1
+
+    def rank(self, frame_stati, now_seconds, timestamp_to_seconds):
+        """
+        Returns the candidates ordered by expected coverage per claim cost,
+        best first. Candidates below min_probability are dropped at random,
+        in proportion to how unlikely their claim is.
+        """
+        scored = []
+        for frame_status in frame_stati:
+            (probability, cost) = self.predict(frame_status)
+
+            if probability < self.min_probability and random.random() * self.min_probability > probability:
+                self.num_skipped += 1
+                continue
+
+            age = now_seconds - timestamp_to_seconds(frame_status.last_successfull_test)
+            scored.append((probability * (age + 1) / (cost + 1), frame_status))
+
+        scored.sort(key = lambda (score, frame_status): score, reverse = True)
+        return [frame_status for (score, frame_status) in scored]
+
+    def print_stats(self):
+        known = [[region for region in xrange(len(self.probabilities[klass])) if self.probabilities[klass][region] != NO_HISTORY]
+                 for klass in xrange(len(CLASS_NAMES))]
+
+        print("Claim predictor: %d regions, %d updates, %d unlikely candidates skipped" % (sum([len(regions) for regions in known]), self.num_updates, self.num_skipped))
+        for klass in xrange(len(CLASS_NAMES)):
+            regions = known[klass]
+            if regions:
+                print("\t%-12s regions: %6d  mean P(claimed): %.2f  mean cost: %.2f jiffies" % (CLASS_NAMES[klass], len(regions),
+                        sum([self.probabilities[klass][r] for r in regions]) / len(regions), sum([self.costs[klass][r] for r in regions]) / len(regions)))
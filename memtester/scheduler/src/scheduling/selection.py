@@ -0,0 +1,77 @@
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+
+"""
+ Selects the test algorithm for a frame.
+"""
+
+
+class FixedSelector(object):
+    '''
+    Always selects the same test algorithm.
+    '''
+
+    def __init__(self, frame_test):
+        self.frame_test = frame_test
+
+    def select(self, coverage_status):
+        return self.frame_test
+
+    def name(self):
+        return self.frame_test.name()
+
+
+class OldestGapSelector(object):
+    '''
+    Selects the test algorithm that fills the oldest coverage gap of a frame.
+
+    `frame_tests` is ordered by cost, cheapest first. Each test declares the
+    fault models it covers in FAULT_MODELS. For the model that has been
+    covered longest ago (never covered models first), the cheapest test
+    covering that model is selected. Expensive tests therefore only run on
+    frames where they add coverage.
+    '''
+
+    def __init__(self, frame_tests):
+        if not frame_tests:
+            raise ValueError("At least one test algorithm is needed")
+        self.frame_tests = frame_tests
+
+        self.all_models = 0
+        for frame_test in frame_tests:
+            self.all_models |= frame_test.FAULT_MODELS
+
+    def select(self, coverage_status):
+        if coverage_status is None:
+            return self.frame_tests[0]
+
+        gap = coverage_status.oldest_gap(self.all_models)
+        for frame_test in self.frame_tests:
+            if frame_test.FAULT_MODELS & gap:
+                return frame_test
+
+        return self.frame_tests[0]
+
+    def name(self):
+        return "oldest coverage gap of (%s)" % ", ".join([frame_test.name() for frame_test in self.frame_tests])
@@ -0,0 +1,124 @@
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+
+"""
+ Runs the tests of several frames interleaved, in time slices.
+
+ Every test is a tester.resumable.ResumableTest. The slicer gives each
+ unfinished test one slice in turn. Between two rounds it asks the
+ pressure probe whether the host needs the CPU and memory bandwidth back;
+ if so, the unfinished tests are abandoned. Finished tests keep their
+ result, so the frames tested up to that point are recorded as usual, the
+ abandoned ones are tested in a later run.
+"""
+
+import time
+
+
+def read_procs_running(path = "/proc/stat"):
+    """
+    The number of runnable tasks right now (`procs_running` in /proc/stat),
+    including the tester itself
+    """
+    with open(path) as stat:
+        for line in stat:
+            if line.startswith("procs_running "):
+                return int(line.split()[1])
+    raise ValueError("%s has no procs_running" % path)
+
+
+class LoadPressure(object):
+    '''
+    Reports pressure while more than `max_load` tasks are runnable.
+
+    The 1 minute load average reacts to a load change only after tens of
+    seconds, long after the slices it should have stopped. procs_running is
+    the instantaneous run queue length; it is sampled at most every
+    `interval` seconds and averaged over the last `window` samples to ride
+    out single spikes. A change of the load therefore shows within
+    interval * window seconds (40 ms by default).
+    '''
+
+    def __init__(self, max_load, interval = 0.01, window = 4, read_running = read_procs_running):
+        self.max_load = max_load
+        self.interval = interval
+        self.read_running = read_running
+        self.samples = [0] * window
+        self.num_samples = 0
+        self.next_check = 0
+        self.pressured = False
+
+    def is_pressured(self):
+        now = time.time()
+        if now >= self.next_check:
+            self.samples[self.num_samples % len(self.samples)] = self.read_running()
+            self.num_samples += 1
+            num_valid = min(self.num_samples, len(self.samples))
+            self.pressured = float(sum(self.samples)) / num_valid > self.max_load
+            self.next_check = now + self.interval
+        return self.pressured
+
+
+class TimeSlicer(object):
+    '''
+    Interleaves ResumableTests in slices of `slice_seconds`
+    '''
+
+    def __init__(self, slice_seconds, pressure = None):
+        self.slice_seconds = slice_seconds
+        self.pressure = pressure
+        self.num_finished = 0
+        self.num_abandoned = 0
+        self.num_slices = 0
+
+    def run(self, tests):
+        """
+        Run the tests round robin until all have finished, or until the
+        pressure probe reports pressure.
+
+        return: the tests that have been abandoned
+        """
+        pending = list(tests)
+
+        while pending:
+            still_pending = []
+            for test in pending:
+                self.num_slices += 1
+                if test.run_slice(self.slice_seconds):
+                    self.num_finished += 1
+                else:
+                    still_pending.append(test)
+            pending = still_pending
+
+            if pending and self.pressure and self.pressure.is_pressured():
+                for test in pending:
+                    test.abandon()
+                self.num_abandoned += len(pending)
+                return pending
+
+        return []
+
+    def print_stats(self):
+        print("Time slices of %d us: %d slices, %d tests finished, %d abandoned under pressure" %
+              (self.slice_seconds * 1000000, self.num_slices, self.num_finished, self.num_abandoned))
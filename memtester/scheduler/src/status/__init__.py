@@ -23,4 +23,6 @@ THE SOFTWARE.
 '''
 from configuration import FileBasedConfiguration
 from timestamping import TimestampingFacility
-
+from coverage import CoverageStatus
+from backoff import BackoffStatus
+from compact import CompactFrameStatus, LegacyFrameStatus, StatusFileHeader
@@ -0,0 +1,101 @@
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+
+from ctypes import *
+
+import physmem
+
+from compact import EpochRelativeRecord, timestamp_property
+
+# Upper bound of the backoff, also used for frames that should never be retried
+MAX_BACKOFF_SECONDS = 60 * 60 * 24
+
+
+class LegacyBackoffStatus(Structure):
+    '''
+    The 16 byte claim backoff written by earlier versions (absolute retry_at)
+    '''
+
+    _fields_ = [("retry_at", c_uint64),
+                ("failure_reason", c_uint32),
+                ("consecutive_failures", c_uint32)]
+
+    def timestamps(self):
+        return (self.retry_at,)
+
+
+class BackoffStatus(EpochRelativeRecord):
+    '''
+    The claim backoff of a single frame. Stored in its own
+    FileBasedConfiguration next to the frame status (`<status_file>.backoff`),
+    8 bytes per frame.
+
+    - `retry_at` is the timestamp (status.TimestampingFacility) before which
+      the frame is not requested again. 0 means now. It is stored as ticks
+      relative to the epoch of the file, rounded up (status.compact).
+    - `failure_reason` is the physmem.CLAIM_FAILURE_* of the last failed claim
+    - `consecutive_failures` counts the failed claims since the last success.
+
+    The backoff starts at the retry hint of the module and doubles with every
+    consecutive failure, up to MAX_BACKOFF_SECONDS.
+    '''
+
+    _fields_ = [("retry_at_ticks", c_uint32),
+                ("failure_reason", c_uint32, 8),
+                ("consecutive_failures", c_uint32, 8),
+                ("reserved", c_uint32, 16)]
+
+    legacy = LegacyBackoffStatus
+
+    retry_at = timestamp_property("retry_at_ticks")
+
+    def __str__(self):
+        return " retry_at: %d, failure_reason: %d, consecutive_failures: %d" % (self.retry_at, self.failure_reason, self.consecutive_failures)
+
+    def record_failure(self, failure_reason, retry_after_ms, now, timestamping):
+        """
+        The frame could not be claimed at `now` (a timestamp)
+        """
+        self.failure_reason = failure_reason
+        self.consecutive_failures = min(self.consecutive_failures + 1, 32)
+
+        if physmem.CLAIM_RETRY_NEVER == retry_after_ms:
+            seconds = MAX_BACKOFF_SECONDS
+        else:
+            seconds = min(MAX_BACKOFF_SECONDS, retry_after_ms / 1000.0 * (1 << (self.consecutive_failures - 1)))
+
+        self.retry_at = now + timestamping.seconds_to_timestamp(seconds)
+
+    def copy_from(self, other):
+        self.retry_at = other.retry_at
+        self.failure_reason = min(other.failure_reason, 0xFF)
+        self.consecutive_failures = min(other.consecutive_failures, 32)
+
+    def record_success(self):
+        self.retry_at = 0
+        self.failure_reason = physmem.CLAIM_FAILURE_NONE
+        self.consecutive_failures = 0
+
+    def is_backing_off(self, now):
+        return now < self.retry_at
@@ -0,0 +1,304 @@
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+
+"""
+ Compact encoding of the per-frame status.
+
+ The legacy record (LegacyFrameStatus) has four 64 bit fields and two 32 bit
+ fields: 40 bytes per 4 KiB frame, i.e. 10 GiB of status for a 1 TiB host.
+ CompactFrameStatus stores the same information in 16 bytes:
+
+ - the three timestamps as 32 bit tick counts relative to a per-file epoch,
+   one tick is TIMESTAMP_RESOLUTION timestamps (1 s). 0 still means never.
+   Timestamps are rounded up to the next tick, so a frame never appears to
+   have been tested earlier than it was. 2^32 s cover 136 years.
+ - the error count (saturating at 255), the claim cost in jiffies
+   (saturating at 4095) and the claiming method packed into 32 bits. Of the
+   method, the SOURCE_* bits up to 0x400 are kept and all SOURCE_ERROR_*
+   bits are folded into SOURCE_ERROR_NOT_MAPPABLE.
+
+ The fields read and write like the legacy ones (timestamps in
+ TimestampingFacility units), so the schedulers do not see the difference.
+
+ The sidecar ledgers next to the status file (status.coverage, 16 bytes, and
+ status.backoff, 8 bytes) store their timestamps the same way: all records
+ derive from EpochRelativeRecord.
+
+ A compact status file starts with a StatusFileHeader (magic, version, record
+ size, epoch). A file without the header is taken as a legacy file of the
+ record class (its `legacy` class) and migrated by
+ FileBasedConfiguration.open() (migrate_legacy()).
+"""
+
+import os
+import mmap
+
+from ctypes import *
+
+from timestamping import TimestampingFacility
+
+STATUS_MAGIC = "MTSTATUS"
+STATUS_VERSION = 2
+
+# Timestamps (1/100 s) per tick
+TIMESTAMP_RESOLUTION = 100
+
+MAX_TICKS = 0xFFFFFFFF
+
+NUM_ERRORS_BITS = 8
+CLAIMING_TIME_BITS = 12
+CLAIMING_METHOD_BITS = 12
+
+# physmem.SOURCE_ERROR_NOT_MAPPABLE, the only error a claim can carry
+SOURCE_ERROR_NOT_MAPPABLE = 0x100000
+SOURCE_ERROR_MASK = 0xFFF00000
+
+# Method bit 11 stands for any SOURCE_ERROR_*
+_METHOD_ERROR_BIT = 1 << (CLAIMING_METHOD_BITS - 1)
+_METHOD_SOURCE_MASK = _METHOD_ERROR_BIT - 1
+
+
+class StatusFileHeader(Structure):
+    '''
+    The first 64 bytes of a compact status file
+    '''
+
+    _fields_ = [("magic", c_char * 8),
+                ("version", c_uint32),
+                ("record_size", c_uint32),
+                ("epoch", c_uint64),
+                ("resolution", c_uint32),
+                ("reserved", c_uint32 * 9)]
+
+    def initialize(self, record_size, epoch):
+        self.version = STATUS_VERSION
+        self.record_size = record_size
+        self.epoch = long(epoch)
+        self.resolution = TIMESTAMP_RESOLUTION
+        # Last: the header is valid once the magic is set
+        self.magic = STATUS_MAGIC
+
+    def is_initialized(self):
+        return STATUS_MAGIC == self.magic
+
+    def check(self, path, record_size):
+        if self.version != STATUS_VERSION or self.record_size != record_size or not self.resolution:
+            raise ValueError("%s: unsupported status file (version %d, record size %d)" % (path, self.version, self.record_size))
+
+
+class LegacyFrameStatus(Structure):
+    '''
+    The 40 byte frame status written by earlier versions
+    '''
+
+    _fields_ = [("last_successfull_test", c_uint64), ("last_failed_test", c_uint64), ("last_claiming_time_jiffies", c_uint64),
+                      ("last_claiming_attempt", c_uint64),
+                      ("num_errors", c_uint32),
+                      ("last_successfull_claiming_method", c_uint32)]
+
+    def timestamps(self):
+        return (self.last_successfull_test, self.last_failed_test, self.last_claiming_attempt)
+
+
+def to_ticks(timestamp, epoch, resolution):
+    """
+    A timestamp as ticks since `epoch`, rounded up. 0 stays 0 (never).
+    """
+    if not timestamp:
+        return 0
+    ticks = -(-(long(timestamp) - epoch) // resolution)
+    return min(max(ticks, 1), MAX_TICKS)
+
+
+def from_ticks(ticks, epoch, resolution):
+    if not ticks:
+        return 0
+    return epoch + ticks * resolution
+
+
+def timestamp_property(field):
+    def get(self):
+        return from_ticks(getattr(self, field), self.epoch, self.resolution)
+
+    def set(self, timestamp):
+        setattr(self, field, to_ticks(timestamp, self.epoch, self.resolution))
+
+    return property(get, set)
+
+
+def _saturating_property(field, bits):
+    def get(self):
+        return getattr(self, field)
+
+    def set(self, value):
+        setattr(self, field, min(max(long(value), 0), (1 << bits) - 1))
+
+    return property(get, set)
+
+
+def _pack_method(method):
+    packed = method & _METHOD_SOURCE_MASK
+    if method & SOURCE_ERROR_MASK:
+        packed |= _METHOD_ERROR_BIT
+    return packed
+
+
+def _unpack_method(packed):
+    method = packed & _METHOD_SOURCE_MASK
+    if packed & _METHOD_ERROR_BIT:
+        method |= SOURCE_ERROR_NOT_MAPPABLE
+    return method
+
+
+class EpochRelativeRecord(Structure):
+    '''
+    A record with timestamps relative to the epoch of its file. Instances
+    read from a file are of a subclass bound to that epoch (bind()).
+    Subclasses name the headerless record they replace in `legacy` (with
+    timestamps() and read by copy_from()), or None.
+    '''
+
+    # Overridden by bind()
+    epoch = 0
+    resolution = TIMESTAMP_RESOLUTION
+
+    legacy = None
+
+    @classmethod
+    def bind(cls, header):
+        """
+        A subclass reading and writing timestamps relative to the epoch in `header`
+        """
+        return type(cls.__name__, (cls,), {"epoch": header.epoch, "resolution": header.resolution})
+
+
+class CompactFrameStatus(EpochRelativeRecord):
+    '''
+    The 16 byte frame status, see above.
+    '''
+
+    _fields_ = [("last_successfull_test_ticks", c_uint32),
+                ("last_failed_test_ticks", c_uint32),
+                ("last_claiming_attempt_ticks", c_uint32),
+                ("num_errors_packed", c_uint32, NUM_ERRORS_BITS),
+                ("last_claiming_time_packed", c_uint32, CLAIMING_TIME_BITS),
+                ("last_claiming_method_packed", c_uint32, CLAIMING_METHOD_BITS)]
+
+    legacy = LegacyFrameStatus
+
+    last_successfull_test = timestamp_property("last_successfull_test_ticks")
+    last_failed_test = timestamp_property("last_failed_test_ticks")
+    last_claiming_attempt = timestamp_property("last_claiming_attempt_ticks")
+
+    num_errors = _saturating_property("num_errors_packed", NUM_ERRORS_BITS)
+    last_claiming_time_jiffies = _saturating_property("last_claiming_time_packed", CLAIMING_TIME_BITS)
+
+    def _get_method(self):
+        return _unpack_method(self.last_claiming_method_packed)
+
+    def _set_method(self, method):
+        self.last_claiming_method_packed = _pack_method(method)
+
+    last_successfull_claiming_method = property(_get_method, _set_method)
+
+    def copy_from(self, other):
+        self.last_successfull_test = other.last_successfull_test
+        self.last_failed_test = other.last_failed_test
+        self.last_claiming_attempt = other.last_claiming_attempt
+        self.num_errors = other.num_errors
+        self.last_claiming_time_jiffies = other.last_claiming_time_jiffies
+        self.last_successfull_claiming_method = other.last_successfull_claiming_method
+
+
+def _min_legacy_timestamp(records, num_records):
+    epoch = None
+    for index in xrange(0, num_records):
+        for timestamp in records(index).timestamps():
+            if timestamp and (None == epoch or timestamp < epoch):
+                epoch = timestamp
+    return epoch
+
+
+def migrate_legacy(path, clazz):
+    """
+    If `path` is a legacy file of `clazz` (clazz.legacy records, no header),
+    rewrite it in the compact format of `clazz`. The old file is replaced
+    atomically once the new one is complete. Returns the number of migrated
+    records, None if there was nothing to migrate.
+    """
+    if not clazz.legacy:
+        return None
+
+    try:
+        size = os.path.getsize(path)
+    except OSError:
+        return None
+
+    if not size:
+        return None
+
+    legacy_size = sizeof(clazz.legacy)
+    with open(path, "rb") as f:
+        if STATUS_MAGIC == f.read(len(STATUS_MAGIC)):
+            return None
+        if size % legacy_size:
+            raise ValueError("%s is neither a compact nor a legacy file (%d bytes)" % (path, size))
+
+        num_records = size / legacy_size
+        legacy_map = mmap.mmap(f.fileno(), size, access = mmap.ACCESS_COPY)
+
+    records = lambda index: clazz.legacy.from_buffer(legacy_map, index * legacy_size)
+    # Tick 0 means never, and later timestamps (a backoff may be shorter
+    # than the one migrated) must not be before the epoch
+    epoch = TimestampingFacility().timestamp()
+    oldest = _min_legacy_timestamp(records, num_records)
+    if None != oldest:
+        epoch = min(epoch, oldest)
+    epoch -= TIMESTAMP_RESOLUTION
+
+    header_size = sizeof(StatusFileHeader)
+    record_size = sizeof(clazz)
+    new_size = header_size + num_records * record_size
+    tmp_path = path + ".migrating"
+
+    with open(tmp_path, "w+b") as f:
+        f.truncate(new_size)
+        new_map = mmap.mmap(f.fileno(), new_size)
+
+        header = StatusFileHeader.from_buffer(new_map, 0)
+        header.initialize(record_size, epoch)
+        bound = clazz.bind(header)
+
+        for index in xrange(0, num_records):
+            bound.from_buffer(new_map, header_size + index * record_size).copy_from(records(index))
+
+        new_map.flush()
+        new_map.close()
+        os.fsync(f.fileno())
+
+    legacy_map.close()
+    os.rename(tmp_path, path)
+
+    print("Migrated %d frame records in %s to the compact format: %d -> %d bytes" % (num_records, path, size, new_size))
+    return num_records
@@ -29,6 +29,8 @@ import struct
 from ctypes import *
 import sys
 
+import compact
+
 
 def _open_create( path, len):
     """ Open the file and make it the length passed. If the file does not exist, create it and fill it with 0"""
@@ -64,7 +66,9 @@ class FileBasedConfiguration():
        inst2.status = 6789
        print(inst1.status) # --> 6789
        
-       
+    - Record classes with a bind() classmethod (status.compact) get a file
+      header, and are bound to it when the file is opened. Legacy files of
+      such classes are migrated on open.
     '''
 
     def __init__(self,  path, num_frames, instance_clazz):
@@ -74,6 +78,9 @@ class FileBasedConfiguration():
         self.path = path
         self.file = None
         self.map = None
+        self.with_header = hasattr(instance_clazz, "bind")
+        self.header_size = sizeof(compact.StatusFileHeader) if self.with_header else 0
+        self.record_clazz = instance_clazz
 
 
     def get_record_count(self):
@@ -84,11 +91,26 @@ class FileBasedConfiguration():
 
   
     def open(self):
+        """
+        Opens the file, migrating a legacy file and initialising the header
+        first. Not synchronised: the first open must not run concurrently
+        (e.g. in forked workers).
+        """
         self.close()
-        size = self.num_frames * self.record_size
+        if self.with_header:
+            compact.migrate_legacy(self.path, self.instance_clazz)
+
+        size = self.header_size + self.num_frames * self.record_size
         self.file = _open_create(self.path,  size)
         fileno = self.file.fileno()
         self.map = mmap.mmap(fileno, size)
+
+        if self.with_header:
+            header = compact.StatusFileHeader.from_buffer(self.map, 0)
+            if not header.is_initialized():
+                header.initialize(self.record_size, compact.TimestampingFacility().timestamp())
+            header.check(self.path, self.record_size)
+            self.record_clazz = self.instance_clazz.bind(header)
         return self
 
     def close(self):
@@ -109,8 +131,8 @@ class FileBasedConfiguration():
     def __getitem__(self, key):
         if not self.file:
             return None
-        offset = key * self.record_size
-        ret = self.instance_clazz.from_buffer(self.map, offset)
+        offset = self.header_size + key * self.record_size
+        ret = self.record_clazz.from_buffer(self.map, offset)
 
         return ret
     
@@ -0,0 +1,121 @@
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+
+from ctypes import *
+
+from tester.fault_models import ALL_FAULT_MODELS, NUM_FAULT_MODELS
+
+from compact import EpochRelativeRecord, to_ticks, from_ticks
+from timestamping import TimestampingFacility
+
+_timestamping = TimestampingFacility()
+
+
+class LegacyCoverageStatus(Structure):
+    '''
+    The 20 byte coverage ledger written by earlier versions (absolute seconds)
+    '''
+
+    _fields_ = [("covered", c_uint32),
+                ("last_covered", c_uint32 * NUM_FAULT_MODELS)]
+
+    def timestamps(self):
+        return [_timestamping.seconds_to_timestamp(seconds) for seconds in self.last_covered]
+
+
+class CoverageStatus(EpochRelativeRecord):
+    '''
+    The fault-model coverage ledger of a single frame. Stored in its own
+    FileBasedConfiguration next to the frame status (`<status_file>.coverage`),
+    16 bytes per frame.
+
+    - `last_covered[i]` is the time (seconds since the epoch) of the last
+      successful test that covered ALL_FAULT_MODELS[i]. 0 means never. It is
+      stored as ticks relative to the epoch of the file (status.compact).
+    - `covered` is the bitmask of fault models (tester.fault_models) with a
+      coverage
+    '''
+
+    _fields_ = [("last_covered_ticks", c_uint32 * NUM_FAULT_MODELS)]
+
+    legacy = LegacyCoverageStatus
+
+    def __str__(self):
+        return " covered: %x, last_covered: %s" % (self.covered, self.last_covered)
+
+    def _get_last_covered(self):
+        return [_timestamping.timestamp_to_seconds(from_ticks(ticks, self.epoch, self.resolution)) for ticks in self.last_covered_ticks]
+
+    last_covered = property(_get_last_covered)
+
+    def _get_covered(self):
+        covered = 0
+        for (index, model) in enumerate(ALL_FAULT_MODELS):
+            if self.last_covered_ticks[index]:
+                covered |= model
+        return covered
+
+    covered = property(_get_covered)
+
+    def _set_last_covered(self, index, seconds):
+        self.last_covered_ticks[index] = to_ticks(_timestamping.seconds_to_timestamp(seconds), self.epoch, self.resolution)
+
+    def record(self, fault_models, seconds):
+        """
+        A test covering `fault_models` has passed at `seconds`
+        """
+        for (index, model) in enumerate(ALL_FAULT_MODELS):
+            if fault_models & model:
+                self._set_last_covered(index, seconds)
+
+    def reset(self, fault_models):
+        """
+        Forget the coverage of `fault_models`, e.g. after a test has failed.
+        """
+        for (index, model) in enumerate(ALL_FAULT_MODELS):
+            if fault_models & model:
+                self.last_covered_ticks[index] = 0
+
+    def copy_from(self, other):
+        for index in xrange(0, NUM_FAULT_MODELS):
+            self._set_last_covered(index, other.last_covered[index])
+
+    def last_covered_for(self, fault_model):
+        return self.last_covered[ALL_FAULT_MODELS.index(fault_model)]
+
+    def oldest_gap(self, fault_models = None):
+        """
+        Returns the fault model (out of fault_models, default: all) that has
+        been covered longest ago -- uncovered models first.
+        """
+        oldest = None
+        oldest_ticks = None
+        for (index, model) in enumerate(ALL_FAULT_MODELS):
+            if fault_models and not (fault_models & model):
+                continue
+            ticks = self.last_covered_ticks[index]
+            if (oldest_ticks is None) or (ticks < oldest_ticks):
+                oldest = model
+                oldest_ticks = ticks
+        return oldest
@@ -22,5 +22,8 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 '''
 
+import fault_models
+import resumable
 from linear import LinearScanner
 from quadratic import QuadraticScanner
+from native_linear import NativeLinearScanner
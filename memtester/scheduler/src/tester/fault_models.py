@@ -0,0 +1,52 @@
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+
+"""
+ The fault models a test algorithm can detect. A tester declares the models
+ it covers in `FAULT_MODELS` (a bitmask of the values below). The coverage
+ ledger (status.coverage) records per frame and model when it was covered
+ last.
+"""
+
+STUCK_AT         =  1 << 0    # A cell is stuck at 0 or 1
+TRANSITION       =  1 << 1    # A cell fails to make a 0->1 or 1->0 transition
+ADDRESS_DECODER  =  1 << 2    # Two addresses access the same cell, or an address accesses no cell
+COUPLING         =  1 << 3    # Writing a cell changes the content of another cell
+
+NUM_FAULT_MODELS = 4
+
+ALL_FAULT_MODELS = [STUCK_AT, TRANSITION, ADDRESS_DECODER, COUPLING]
+
+FAULT_MODEL_NAMES = {
+    STUCK_AT : 'STUCK_AT',
+    TRANSITION : 'TRANSITION',
+    ADDRESS_DECODER : 'ADDRESS_DECODER',
+    COUPLING : 'COUPLING'
+    }
+
+def index_of(fault_model):
+    """
+    The index of a single fault model, e.g. into CoverageStatus.last_covered
+    """
+    return ALL_FAULT_MODELS.index(fault_model)
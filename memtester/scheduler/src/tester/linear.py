@@ -4,11 +4,17 @@ Created on Jun 1, 2010
 @author: jens
 '''
 
+from resumable import RUNNING, STEP_BYTES, run_to_completion
+from fault_models import STUCK_AT, TRANSITION, ADDRESS_DECODER
+
 class LinearScanner(object):
     '''
     Scans a memory region (mmap) with linear complexity
     '''
 
+    # all-0, all-1 and a pattern derived from the address
+    FAULT_MODELS = STUCK_AT | TRANSITION | ADDRESS_DECODER
+
 
     def __init__(self, reporting):
         '''
@@ -25,35 +31,46 @@ class LinearScanner(object):
         - region supports __getitem(x)__ and __setitem(x,b)__, with b being casted to a byte 
         - offset is the first byte tested, len is the length (1..X). The bytes region[offset..offset+(length -1)] are tested
         
-        return: last tested offset
+        return: True, if no errors have been found
+        """
+        return run_to_completion(self.steps(region, offset, len))
+
+    def steps(self, region, offset, len):
+        """
+        The test as a resumable generator (see resumable.py): yields RUNNING
+        after every STEP_BYTES bytes of each pass, finally True if no errors
+        have been found.
         """
-        
         last_element = offset+len
-        # Test all ZEROes
-        for index in xrange(offset, last_element):
-            region[index] = 0
-        
-        for index in xrange(offset, last_element):
-            v =  region[index]
-            if not (v == 0):
-                self.reporting.report_bad_memory(index, 0, v)
-
-        # Test all ONEs
-        for index in xrange(offset, last_element):
-            region[index] = 0xff
-       
-        for index in xrange(offset, last_element):
-            v =  region[index]
-            if not (v == 0xff):
-                self.reporting.report_bad_memory(index, 0xff, v)
+        num_errors = 0
+
+        # Test all ZEROes, then all ONEs
+        for value in (0, 0xff):
+            for step in xrange(offset, last_element, STEP_BYTES):
+                for index in xrange(step, min(step + STEP_BYTES, last_element)):
+                    region[index] = value
+                yield RUNNING
+
+            for step in xrange(offset, last_element, STEP_BYTES):
+                for index in xrange(step, min(step + STEP_BYTES, last_element)):
+                    v =  region[index]
+                    if not (v == value):
+                        self.reporting.report_bad_memory(index, value, v)
+                        num_errors += 1
+                yield RUNNING
 
         # Test all ADDRESS
-        for index in xrange(offset, last_element):
-            region[index] = index % 0xff
-       
-        for index in xrange(offset, last_element):
-            v =  region[index]
-            if not (v == (index % 0xff)):
-                self.reporting.report_bad_memory(index, (index % 0xff), v)
-                
-        return last_element
\ No newline at end of file
+        for step in xrange(offset, last_element, STEP_BYTES):
+            for index in xrange(step, min(step + STEP_BYTES, last_element)):
+                region[index] = index % 0xff
+            yield RUNNING
+
+        for step in xrange(offset, last_element, STEP_BYTES):
+            for index in xrange(step, min(step + STEP_BYTES, last_element)):
+                v =  region[index]
+                if not (v == (index % 0xff)):
+                    self.reporting.report_bad_memory(index, (index % 0xff), v)
+                    num_errors += 1
+            yield RUNNING
+
+        yield num_errors == 0
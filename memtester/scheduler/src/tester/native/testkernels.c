@@ -0,0 +1,183 @@
+/*
+    This source code is distributed under the MIT License
+
+    Copyright (c) 2010, Jens Neuhalfen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+ */
+
+/**
+ * See testkernels.h for a complete documentation!
+ */
+
+#include <emmintrin.h>          /* SSE2: movnti, clflush, fences */
+#include <smmintrin.h>          /* SSE4.1: movntdqa */
+
+#include "testkernels.h"
+
+#define CACHE_LINE          (64)
+#define WORDS_PER_LINE      (CACHE_LINE / sizeof (uint64_t))
+
+/* How many lines prefetchnta runs ahead of the streaming verification */
+#define PREFETCH_LINES      (8)
+
+#define PATTERN_ZEROES      0
+#define PATTERN_ONES        1
+#define PATTERN_ADDRESS     2
+
+static const char* variant_names[TESTKERNEL_NUM_VARIANTS] = {
+    [TESTKERNEL_TEMPORAL] = "temporal",
+    [TESTKERNEL_CLFLUSH] = "clflush",
+    [TESTKERNEL_NON_TEMPORAL] = "non-temporal",
+    [TESTKERNEL_STREAMING] = "streaming",
+};
+
+const char* testkernel_name(int variant)
+{
+    if (variant < 0 || variant >= TESTKERNEL_NUM_VARIANTS)
+        return NULL;
+    return variant_names[variant];
+}
+
+static inline uint64_t pattern_value(int pattern, uint64_t offset)
+{
+    switch (pattern) {
+        case PATTERN_ZEROES:
+            return 0;
+        case PATTERN_ONES:
+            return ~0ULL;
+        default:
+            /* Every word holds its own offset: detects address decoder faults */
+            return offset;
+    }
+}
+
+static inline void stream_store(uint64_t* word, uint64_t value)
+{
+#ifdef __x86_64__
+    _mm_stream_si64((long long*) word, (long long) value);
+#else
+    _mm_stream_si32((int*) word, (int) value);
+    _mm_stream_si32(((int*) word) + 1, (int) (value >> 32));
+#endif
+}
+
+/*
+ * Write back and evict region[0..len) from all cache levels
+ */
+static void flush(void* region, size_t len)
+{
+    char* line;
+
+    for (line = region; line < (char*) region + len; line += CACHE_LINE)
+        _mm_clflush(line);
+    _mm_mfence();
+}
+
+static void fill(int variant, uint64_t* words, size_t num_words, int pattern)
+{
+    size_t i;
+
+    if (variant == TESTKERNEL_NON_TEMPORAL || variant == TESTKERNEL_STREAMING) {
+        for (i = 0; i < num_words; i++)
+            stream_store(&words[i], pattern_value(pattern, i * sizeof (uint64_t)));
+        /* Drain the write combining buffers before the lines are read back */
+        _mm_sfence();
+        return;
+    }
+
+    for (i = 0; i < num_words; i++)
+        ((volatile uint64_t*) words)[i] = pattern_value(pattern, i * sizeof (uint64_t));
+
+    /* Force the pattern into the DRAM, so that the verification reads the DRAM and not the cache */
+    if (variant == TESTKERNEL_CLFLUSH)
+        flush(words, num_words * sizeof (uint64_t));
+}
+
+static inline void check(uint64_t actual, int pattern, size_t index, struct testkernel_error* errors, size_t max_errors, long* num_errors)
+{
+    uint64_t expected = pattern_value(pattern, index * sizeof (uint64_t));
+
+    if (actual == expected)
+        return;
+
+    if ((size_t) *num_errors < max_errors) {
+        errors[*num_errors].offset = index * sizeof (uint64_t);
+        errors[*num_errors].expected = expected;
+        errors[*num_errors].actual = actual;
+    }
+    (*num_errors)++;
+}
+
+static void verify(int variant, uint64_t* words, size_t num_words, int pattern, struct testkernel_error* errors, size_t max_errors, long* num_errors)
+{
+    size_t i, j;
+
+    if (variant == TESTKERNEL_STREAMING) {
+        size_t num_lines = num_words / WORDS_PER_LINE;
+        size_t line;
+
+        for (line = 0; line < num_lines; line++) {
+            __m128i* chunk = (__m128i*) &words[line * WORDS_PER_LINE];
+
+            if (line + PREFETCH_LINES < num_lines)
+                _mm_prefetch((const char*) &words[(line + PREFETCH_LINES) * WORDS_PER_LINE], _MM_HINT_NTA);
+
+            for (j = 0; j < CACHE_LINE / sizeof (__m128i); j++) {
+                uint64_t pair[2];
+
+                _mm_storeu_si128((__m128i*) pair, _mm_stream_load_si128(&chunk[j]));
+                i = line * WORDS_PER_LINE + j * 2;
+                check(pair[0], pattern, i, errors, max_errors, num_errors);
+                check(pair[1], pattern, i + 1, errors, max_errors, num_errors);
+            }
+        }
+    } else {
+        for (i = 0; i < num_words; i++)
+            check(((volatile uint64_t*) words)[i], pattern, i, errors, max_errors, num_errors);
+    }
+
+    /* The verified lines are of no use to anybody: make room for the production workload */
+    if (variant != TESTKERNEL_TEMPORAL)
+        flush(words, num_words * sizeof (uint64_t));
+}
+
+long testkernel_linear(int variant, void* region, size_t len, struct testkernel_error* errors, size_t max_errors)
+{
+    static const int patterns[] = {PATTERN_ZEROES, PATTERN_ONES, PATTERN_ADDRESS};
+    size_t num_words = len / sizeof (uint64_t);
+    long num_errors = 0;
+    size_t p;
+
+    if (!testkernel_name(variant))
+        return -1;
+
+    if (((uintptr_t) region % CACHE_LINE) || (len % CACHE_LINE))
+        return -1;
+
+    if (!errors)
+        max_errors = 0;
+
+    for (p = 0; p < sizeof (patterns) / sizeof (patterns[0]); p++) {
+        fill(variant, region, num_words, patterns[p]);
+        verify(variant, region, num_words, patterns[p], errors, max_errors, &num_errors);
+    }
+
+    return num_errors;
+}
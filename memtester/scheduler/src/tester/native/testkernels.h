@@ -0,0 +1,88 @@
+/*
+    This source code is distributed under the MIT License
+
+    Copyright (c) 2010, Jens Neuhalfen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+ */
+
+/**
+ * Native test kernels with a small cache footprint.
+ *
+ * All kernels run the same algorithm as tester/linear.py (all zeroes, all
+ * ones, address pattern) on 64 bit words and therefore detect the same
+ * fault models. They only differ in how they touch the cache:
+ *
+ *  TESTKERNEL_TEMPORAL      plain stores and loads. The tested lines evict
+ *                           the working set of the production workload, and
+ *                           the verification mostly reads the cache, not
+ *                           the DRAM. Only used as a baseline.
+ *  TESTKERNEL_CLFLUSH       plain stores, clflush (write back + evict),
+ *                           plain loads, clflush after the verification.
+ *  TESTKERNEL_NON_TEMPORAL  non-temporal stores (movnti, bypass the cache),
+ *                           plain loads, clflush after the verification.
+ *  TESTKERNEL_STREAMING     non-temporal stores, prefetchnta + streaming
+ *                           loads (movntdqa), clflush after the verification.
+ *                           On write-back memory movntdqa behaves like a
+ *                           plain load; prefetchnta is what keeps the line
+ *                           out of (most of) the LLC.
+ *
+ * The region must be 64 byte aligned and its length a multiple of 64 bytes
+ * (i.e. frames).
+ *
+ * The kernels are built into libtestkernels.so (see Makefile) for
+ * tester/native_linear.py, and linked into benchmark/micro/llc_pollution.c.
+ */
+
+#ifndef TESTKERNELS_H_
+#define TESTKERNELS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TESTKERNEL_TEMPORAL         0
+#define TESTKERNEL_CLFLUSH          1
+#define TESTKERNEL_NON_TEMPORAL     2
+#define TESTKERNEL_STREAMING        3
+
+#define TESTKERNEL_NUM_VARIANTS     4
+
+struct testkernel_error {
+    uint64_t offset;       /* byte offset of the bad word, relative to the region */
+    uint64_t expected;
+    uint64_t actual;
+};
+
+/**
+ * Test region[0..len) with `variant`.
+ *
+ * The first max_errors bad words are stored in errors (may be NULL if
+ * max_errors is 0).
+ *
+ * Returns the number of bad words, or -1 if the variant is unknown or the
+ * region is not aligned.
+ */
+long testkernel_linear(int variant, void* region, size_t len, struct testkernel_error* errors, size_t max_errors);
+
+/**
+ * Name of the variant, NULL if unknown.
+ */
+const char* testkernel_name(int variant);
+
+#endif /* TESTKERNELS_H_ */
@@ -0,0 +1,113 @@
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+
+import os
+from ctypes import *
+
+from resumable import RUNNING
+from fault_models import STUCK_AT, TRANSITION, ADDRESS_DECODER
+
+# Must match native/testkernels.h
+VARIANTS = ["temporal", "clflush", "non-temporal", "streaming"]
+
+_LIBRARY_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "native", "libtestkernels.so")
+
+# Only the first MAX_REPORTED_ERRORS bad words of a frame are reported
+MAX_REPORTED_ERRORS = 16
+
+
+class Testkernel_error(Structure):
+    _fields_ = [("offset", c_uint64),
+                ("expected", c_uint64),
+                ("actual", c_uint64)]
+
+
+_library = None
+
+def _load_library():
+    global _library
+    if not _library:
+        if not os.path.exists(_LIBRARY_PATH):
+            raise IOError("%s does not exist. Build it with `make -C %s`" % (_LIBRARY_PATH, os.path.dirname(_LIBRARY_PATH)))
+        _library = CDLL(_LIBRARY_PATH)
+        _library.testkernel_linear.argtypes = [c_int, c_void_p, c_size_t, POINTER(Testkernel_error), c_size_t]
+        _library.testkernel_linear.restype = c_long
+    return _library
+
+
+class NativeLinearScanner(object):
+    '''
+    The algorithm of the LinearScanner, implemented in C (native/testkernels.c).
+
+    The variant selects how the kernel interacts with the caches, see
+    native/testkernels.h. All variants detect the same fault models;
+    `benchmark/micro/llc_pollution.c` measures their impact on a foreground
+    workload.
+    '''
+
+    FAULT_MODELS = STUCK_AT | TRANSITION | ADDRESS_DECODER
+
+
+    def __init__(self, reporting, variant = "non-temporal"):
+        '''
+        Constructor
+        reporting.report_bad_memory(bad_offset, expected_value, actual_value)
+        '''
+        if not variant in VARIANTS:
+            raise ValueError("Unknown variant '%s', expected one of %s" % (variant, VARIANTS))
+
+        self.reporting = reporting
+        self.variant = variant
+        self.library = _load_library()
+
+    def name(self):
+        return "Native linear time test (%s)" % (self.variant,)
+
+    def test(self, region, offset, len):
+        """
+        - region is a physmem.MmapWrapper
+        - offset is the first byte tested, len is the length (multiple of 64). The bytes region[offset..offset+(length -1)] are tested
+
+        return: True, if no errors have been found
+        """
+        errors = (Testkernel_error * MAX_REPORTED_ERRORS)()
+
+        num_errors = self.library.testkernel_linear(VARIANTS.index(self.variant), region.address() + offset, len, errors, MAX_REPORTED_ERRORS)
+        if num_errors < 0:
+            raise ValueError("The test kernel rejected the region at offset 0x%x, length 0x%x (not cache line aligned?)" % (offset, len))
+
+        for error in errors[:min(num_errors, MAX_REPORTED_ERRORS)]:
+            self.reporting.report_bad_memory(offset + error.offset, error.expected, error.actual)
+
+        return num_errors == 0
+
+    def steps(self, region, offset, len):
+        """
+        The test as a resumable generator (see resumable.py). The test
+        kernel runs the three passes over the whole region and cannot be
+        split without losing address decoder coverage across the parts; a
+        frame takes a few microseconds, so it is a single step.
+        """
+        yield RUNNING
+        yield self.test(region, offset, len)
@@ -22,11 +22,17 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 '''
 
+from resumable import RUNNING, STEP_BYTES, run_to_completion
+from fault_models import STUCK_AT, TRANSITION, COUPLING
+
 class QuadraticScanner(object):
     '''
     Scans a memory region (mmap) with n**2  complexity
     '''
 
+    # Each 0->1 write is checked against all other cells
+    FAULT_MODELS = STUCK_AT | TRANSITION | COUPLING
+
 
     def __init__(self, reporting):
         '''
@@ -44,42 +50,59 @@ class QuadraticScanner(object):
         - region supports __getitem(x)__ and __setitem(x,b)__, with b being casted to a byte 
         - offset is the first byte tested, len is the length (1..X). The bytes region[offset..offset+(length -1)] are tested
         
-        return: last tested offset
+        return: True, if no errors have been found
         """
         
+        return run_to_completion(self.steps(region, offset, len))
+
+    def steps(self, region, offset, len):
+        """
+        The test as a resumable generator (see resumable.py): yields RUNNING
+        after every STEP_BYTES bytes written or read, finally True if no
+        errors have been found.
+        """
         last_element = offset+len
-        
+        num_errors = 0
+
         # Test all ZEROes - first reset
-        for index in xrange(offset, last_element):
-            region[index] = 0
-        
-        for index in xrange(offset, last_element):
-            v =  region[index]
-            if not (v == 0):
-                self.reporting.report_bad_memory(index, 0, v)
+        for step in xrange(offset, last_element, STEP_BYTES):
+            for index in xrange(step, min(step + STEP_BYTES, last_element)):
+                region[index] = 0
+            yield RUNNING
+
+        for step in xrange(offset, last_element, STEP_BYTES):
+            for index in xrange(step, min(step + STEP_BYTES, last_element)):
+                v =  region[index]
+                if not (v == 0):
+                    self.reporting.report_bad_memory(index, 0, v)
+                    num_errors += 1
+            yield RUNNING
 
         # Test all ONEs -- quadratic runtime (linear number of writes, quadratic number of reads)
         for index in xrange(offset, last_element):
             region[index] = 0xff
-            
-            for before in xrange(offset, index + 1):
-                v =  region[before]
-                if not (v == 0xff):
-                    self.reporting.report_bad_memory(before, 0xff, v)
-            
-            for after in xrange( index + 1, last_element):
-                v =  region[after]
-                if not (v == 0x00):
-                    self.reporting.report_bad_memory(after, 0x00, v)
-                
-         
+
+            for step in xrange(offset, last_element, STEP_BYTES):
+                for other in xrange(step, min(step + STEP_BYTES, last_element)):
+                    expected = (other <= index) and 0xff or 0x00
+                    v =  region[other]
+                    if not (v == expected):
+                        self.reporting.report_bad_memory(other, expected, v)
+                        num_errors += 1
+                yield RUNNING
+
         # Test all ZEROes - second reset
-        for index in xrange(offset, last_element):
-            region[index] = 0
-        
-        for index in xrange(offset, last_element):
-            v =  region[index]
-            if not (v == 0):
-                self.reporting.report_bad_memory(index, 0, v)
-   
-        return last_element
+        for step in xrange(offset, last_element, STEP_BYTES):
+            for index in xrange(step, min(step + STEP_BYTES, last_element)):
+                region[index] = 0
+            yield RUNNING
+
+        for step in xrange(offset, last_element, STEP_BYTES):
+            for index in xrange(step, min(step + STEP_BYTES, last_element)):
+                v =  region[index]
+                if not (v == 0):
+                    self.reporting.report_bad_memory(index, 0, v)
+                    num_errors += 1
+            yield RUNNING
+
+        yield num_errors == 0
@@ -0,0 +1,107 @@
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+
+"""
+ Test algorithms as resumable state machines.
+
+ Besides test(), which runs to completion, every tester implements
+ steps(region, offset, len): a generator that performs the same test in
+ small steps. It yields RUNNING after each step (a few dozen memory
+ accesses) and, as its last item, the result (True if no errors have been
+ found). All state lives in the generator, so a test can be paused after
+ any step, resumed later, or abandoned.
+
+ ResumableTest runs such a generator in time slices:
+
+   test = ResumableTest(frame_test.steps(map, offset, PAGE_SIZE))
+   while not test.run_slice(0.0001):      # 100 us
+       ...                                # react to the load, test other frames
+   if test.is_ok: ...
+
+ scheduling.slicing interleaves the tests of several frames this way.
+"""
+
+import time
+
+# Yielded by steps() while the test is not finished
+RUNNING = None
+
+# Bytes tested per step of the python testers
+STEP_BYTES = 64
+
+
+class ResumableTest(object):
+    '''
+    A test in progress, driven slice by slice.
+    '''
+
+    def __init__(self, steps):
+        self.steps = steps
+        self.is_ok = None
+        self.is_done = False
+        self.num_slices = 0
+
+    def run_slice(self, seconds):
+        """
+        Advance the test for about `seconds` (at least one step).
+
+        return: True, if the test has finished
+        """
+        if self.is_done:
+            return True
+
+        self.num_slices += 1
+        deadline = time.time() + seconds
+
+        for result in self.steps:
+            if result is not RUNNING:
+                self.is_ok = result
+                self.is_done = True
+                return True
+
+            if time.time() >= deadline:
+                return False
+
+        # The generator ended without a result
+        self.is_done = True
+        return True
+
+    def abandon(self):
+        """
+        Stop the test for good. Resources held by the generator (e.g. a
+        mapping in a `with` block) are released.
+        """
+        if not self.is_done:
+            self.steps.close()
+            self.is_done = True
+
+
+def run_to_completion(steps):
+    """
+    The result of a steps() generator, run without slicing
+    """
+    result = RUNNING
+    for result in steps:
+        pass
+    return result
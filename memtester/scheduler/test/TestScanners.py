@@ -0,0 +1,80 @@
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+
+import unittest
+from tester import LinearScanner, QuadraticScanner
+
+
+class StuckAtRegion(object):
+    '''
+    A bytearray whose byte at `bad_index` has the bits `stuck_bits` stuck at 1
+    '''
+
+    def __init__(self, size, bad_index = None, stuck_bits = 0x01):
+        self.data = bytearray(size)
+        self.bad_index = bad_index
+        self.stuck_bits = stuck_bits
+
+    def __getitem__(self, index):
+        return self.data[index]
+
+    def __setitem__(self, index, value):
+        if index == self.bad_index:
+            value |= self.stuck_bits
+        self.data[index] = value & 0xff
+
+
+class RecordingReporting(object):
+    def __init__(self):
+        self.reports = []
+
+    def report_bad_memory(self, offset, expected, actual):
+        self.reports.append((offset, expected, actual))
+
+
+class Test(unittest.TestCase):
+
+    def check_scanner(self, clazz):
+        reporting = RecordingReporting()
+        scanner = clazz(reporting)
+
+        self.assertTrue(scanner.test(StuckAtRegion(64), 0, 64))
+        self.assertEqual([], reporting.reports)
+
+        self.assertFalse(scanner.test(StuckAtRegion(64, 17), 0, 64))
+        self.assertTrue(len(reporting.reports) > 0)
+        for (offset, expected, actual) in reporting.reports:
+            self.assertEqual(17, offset)
+
+        # Outside of the tested range
+        self.assertTrue(scanner.test(StuckAtRegion(64, 17), 32, 32))
+
+    def testLinearScannerReportsMismatch(self):
+        self.check_scanner(LinearScanner)
+
+    def testQuadraticScannerReportsMismatch(self):
+        self.check_scanner(QuadraticScanner)
+
+if __name__ == "__main__":
+    unittest.main()
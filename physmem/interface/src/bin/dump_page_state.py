@@ -0,0 +1,51 @@
+#!/bin/env python
+"""
+ Dump a snapshot of the page state via the phys_mem module ('Page state'
+ IOCTL) in the format of the /proc/kpageflags and /proc/kpagecount dumps of
+ analyzing/page_usage/collect/collect_kpage.sh, plus the raw extended
+ records (16 bytes per pfn: flags, map count, buddy order, migratetype,
+ zone, node).
+
+   dump_page_state.py OUTDIR POSTFIX
+
+ Prints the names of the files created, like collect_kpage.sh.
+"""
+
+import socket
+import struct
+import sys
+from ctypes import sizeof, string_at
+
+from kpage  import *
+import physmem
+
+WINDOW = 1 << 16
+
+def dump(outdir, postfix):
+    host = socket.gethostname().split('.')[0]
+    names = [ "%s/%s_%s@%s.bin" % (outdir, host, name, postfix) for name in ("kpageflags", "kpagecount", "pagestate") ]
+
+    with kpageflags.FlagsDataSource('flags', "/proc/kpageflags").open() as pf:
+        num_frames = pf.num_frames()
+
+    device = physmem.Physmem("/dev/phys_mem")
+
+    with open(names[0], 'wb') as flags_file:
+        with open(names[1], 'wb') as count_file:
+            with open(names[2], 'wb') as state_file:
+                for start in xrange(0, num_frames, WINDOW):
+                    num = min(WINDOW, num_frames - start)
+                    states = device.page_state(start, num)
+
+                    flags_file.write(struct.pack("%dQ" % (num,), *[state.flags for state in states]))
+                    count_file.write(struct.pack("%dQ" % (num,), *[state.count for state in states]))
+                    state_file.write(string_at(states, num * sizeof(physmem.Phys_mem_page_state)))
+
+    for name in names:
+        print(name)
+
+if len(sys.argv) != 3:
+    print(__doc__)
+    sys.exit(1)
+
+dump(sys.argv[1], sys.argv[2])
@@ -27,6 +27,10 @@ from physmem import Phys_mem_request
 from physmem import Phys_mem_frame_status
 
 from physmem import Mark_page_poison
+from physmem import Phys_mem_layout
+from physmem import Phys_mem_page_state
+from physmem import Phys_mem_page_state_request
+from page_state import PageStateSource
 
 from physmem import PAGE_SIZE
 
@@ -37,4 +41,24 @@ from physmem import SOURCE_ANONYMOUS
 from physmem import SOURCE_ANY_PAGE
 from physmem import SOURCE_HW_POISON_ANON
 from physmem import SOURCE_HW_POISON_PAGE_CACHE
+from physmem import SOURCE_DIRTY_PAGE_CACHE
+from physmem import SOURCE_SWAP_CACHE
+
+from physmem import LAYOUT_DENSE
+from physmem import LAYOUT_PFN_INDEXED
+
+from physmem import PAGE_STATE_NONE
+
+from physmem import CLAIM_FAILURE_NONE
+from physmem import CLAIM_FAILURE_NOT_ALLOWED
+from physmem import CLAIM_FAILURE_RACE
+from physmem import CLAIM_FAILURE_BUSY
+from physmem import CLAIM_FAILURE_IN_USE
+from physmem import CLAIM_FAILURE_MIGRATION
+from physmem import CLAIM_FAILURE_UNMOVABLE
+from physmem import CLAIM_FAILURE_POISONED
+from physmem import CLAIM_FAILURE_PROTECTED
+from physmem import CLAIM_FAILURE_INVALID_PFN
+from physmem import CLAIM_FAILURE_NAMES
+from physmem import CLAIM_RETRY_NEVER
 
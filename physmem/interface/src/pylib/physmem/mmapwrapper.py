@@ -22,6 +22,8 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 '''
 
+import ctypes
+
 class MmapWrapper(object):
     '''
     Extends the mmap base class by implementing the methods used for with "with"
@@ -40,6 +42,13 @@ class MmapWrapper(object):
     def __exit__(self, exc_type, exc_value, traceback):
         if self.__mmap:  self.__mmap.close()
              
+    def address(self):
+        """
+        The virtual address of the first byte of the mapping, e.g. to hand
+        the mapping to native code via ctypes.
+        """
+        return ctypes.addressof(ctypes.c_char.from_buffer(self.__mmap))
+
     def __getattr__(self, name):
         "Delegate pattern"
         return getattr(self.__mmap, name)
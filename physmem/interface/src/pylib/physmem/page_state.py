@@ -0,0 +1,94 @@
+'''
+This source code is distributed under the MIT License
+
+Copyright (c) 2010, Jens Neuhalfen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+'''
+
+"""
+ The extended page state exported by the module ('Page state' IOCTL) as a
+ drop-in replacement for the /proc/kpageflags and /proc/kpagecount data
+ sources.
+
+ Each window of pfns is read with a single IOCTL, so flags, map count and
+ buddy order of a frame are consistent, and there is no per-pfn seek/read.
+"""
+
+import kpage
+
+
+class PageStateSource(object):
+    '''
+    Reads the page state in windows of `window` pfns. Indexing by pfn returns
+    the physmem.Phys_mem_page_state of the frame; a pfn outside the current
+    window reads the window containing it.
+    '''
+
+    def __init__(self, physmem_device, window = 1 << 16):
+        self.physmem_device = physmem_device
+        self.window = window
+        self.first_pfn = None
+        self.states = None
+
+    def invalidate(self):
+        """
+        Drop the current window, e.g. after claiming frames out of it
+        """
+        self.first_pfn = None
+        self.states = None
+
+    def __getitem__(self, pfn):
+        if self.first_pfn is None or not (self.first_pfn <= pfn < self.first_pfn + self.window):
+            self.first_pfn = pfn - pfn % self.window
+            self.states = self.physmem_device.page_state(self.first_pfn, self.window)
+        return self.states[pfn - self.first_pfn]
+
+    def flags(self):
+        """
+        A view indexable like kpage.FlagsDataSource (returns kpage.KPageFlags)
+        """
+        return _FlagsView(self)
+
+    def counts(self):
+        """
+        A view indexable like kpage.CountDataSource (returns the map count)
+        """
+        return _CountView(self)
+
+
+class _FlagsView(object):
+    _instances = {}
+
+    def __init__(self, source):
+        self.source = source
+
+    def __getitem__(self, pfn):
+        flags = self.source[pfn].flags
+        if not _FlagsView._instances.has_key(flags):
+            _FlagsView._instances[flags] = kpage.KPageFlags(flags)
+        return _FlagsView._instances[flags]
+
+
+class _CountView(object):
+    def __init__(self, source):
+        self.source = source
+
+    def __getitem__(self, pfn):
+        return self.source[pfn].count
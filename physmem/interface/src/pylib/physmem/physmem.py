@@ -44,6 +44,29 @@ SOURCE_HW_POISON_ANON   =  0x00020   #       /* Use the HW_POISON claimer */
 SOURCE_HW_POISON_PAGE_CACHE    =  0x00040  #     /* Use the HW_POISON claimer */
 SOURCE_HW_POISON               =       (SOURCE_HW_POISON_ANON |  SOURCE_HW_POISON_PAGE_CACHE)
 
+SOURCE_DIRTY_PAGE_CACHE = 0x00080  #     /* Write back dirty page-cache pages, then claim them like clean ones */
+SOURCE_SWAP_CACHE = 0x00100  #     /* Drop clean unmapped swap-cache pages, write back dirty ones first */
+
+LAYOUT_DENSE                 = 0        # /* Claimed frames are packed in request order */
+LAYOUT_PFN_INDEXED   = 1        # /* A frame is placed at (pfn - base_pfn) * PAGE_SIZE */
+
+PAGE_STATE_NONE         = 0xff     # /* buddy_order: not a free block head. All: no such frame */
+
+CLAIM_FAILURE_NONE          = 0     # /* Claimed */
+CLAIM_FAILURE_NOT_ALLOWED   = 1     # /* No allowed source is responsible for the frame */
+CLAIM_FAILURE_RACE          = 2     # /* The frame changed its state while being claimed */
+CLAIM_FAILURE_BUSY          = 3     # /* Locked or under writeback: transient */
+CLAIM_FAILURE_IN_USE        = 4     # /* Referenced by the kernel or a process */
+CLAIM_FAILURE_MIGRATION     = 5     # /* The content could not be migrated away (soft offline) */
+CLAIM_FAILURE_UNMOVABLE     = 6     # /* Slab, reserved, ..: will never be claimable */
+CLAIM_FAILURE_POISONED      = 7     # /* Marked as hardware poisoned */
+CLAIM_FAILURE_PROTECTED     = 8     # /* Deliberately not touched (first MB, kernel image) */
+CLAIM_FAILURE_INVALID_PFN   = 9     # /* No such frame, or not placeable in the layout */
+
+CLAIM_FAILURE_NAMES = ["none", "not allowed", "race", "busy", "in use", "migration", "unmovable", "poisoned", "protected", "invalid pfn"]
+
+CLAIM_RETRY_NEVER           = 0xFFFFFFFF   # /* retry_after_ms: do not retry */
+
 class Mark_page_poison(Structure):
 
     # struct mark_page_poison{
@@ -54,6 +77,53 @@ class Mark_page_poison(Structure):
                       ("bad_pfn", c_uint64)]
     
     
+class Phys_mem_layout(Structure):
+
+    # struct phys_mem_layout {
+    #  unsigned  long protocol_version; /* The protocol/struct version of this IOCTL call. Must be IOCTL_REQUEST_VERSION */
+    #  unsigned  long layout;           /* PHYS_MEM_LAYOUT_* */
+    #  unsigned  long base_pfn;         /* PHYS_MEM_LAYOUT_PFN_INDEXED: the pfn placed at offset 0. Smaller pfns cannot be requested */
+    # };
+    _fields_ = [("protocol_version", c_uint64),
+                      ("layout", c_uint64),
+                      ("base_pfn", c_uint64)]
+
+
+class Phys_mem_page_state(Structure):
+
+    # struct phys_mem_page_state {
+    #   unsigned long long   flags;          /* As in /proc/kpageflags (KPF_NOPAGE if there is no frame) */
+    #   unsigned int         count;          /* As in /proc/kpagecount: the map count */
+    #   unsigned char        buddy_order;    /* Order of the free block headed by this frame or PHYS_MEM_PAGE_STATE_NONE */
+    #   unsigned char        migratetype;    /* MIGRATE_* of the pageblock */
+    #   unsigned char        zone;           /* Zone index (ZONE_DMA, ZONE_NORMAL, ..) */
+    #   unsigned char        node;           /* NUMA node */
+    # };
+    _fields_ = [("flags", c_uint64),
+                      ("count", c_uint32),
+                      ("buddy_order", c_uint8),
+                      ("migratetype", c_uint8),
+                      ("zone", c_uint8),
+                      ("node", c_uint8)]
+
+    def __str__(self):
+        return "flags:%x, count:%d, buddy_order:%d, migratetype:%d, zone:%d, node:%d" % (self.flags, self.count, self.buddy_order, self.migratetype, self.zone, self.node)
+
+
+class Phys_mem_page_state_request(Structure):
+
+    # struct phys_mem_page_state_request {
+    #  unsigned  long protocol_version; /* The protocol/struct version of this IOCTL call. Must be IOCTL_REQUEST_VERSION */
+    #  unsigned  long start_pfn;        /* The first pfn */
+    #  unsigned  long num_pfns;         /* The number of pfns */
+    #  struct phys_mem_page_state   *states; /* A pointer to the result array. The array must hold at least num_pfns items */
+    # };
+    _fields_ = [("protocol_version", c_uint64),
+                      ("start_pfn", c_uint64),
+                      ("num_pfns", c_uint64),
+                      ("pstates", POINTER(Phys_mem_page_state))]
+
+
 class Phys_mem_frame_request(Structure):
     #/**
     # * A single request for a single pfn
@@ -88,16 +158,20 @@ class Phys_mem_frame_status(Structure):
     #   u64                                  allocation_cost_jiffies;       /* How long did it take to get a hold on this frame? Measured in jiffies*/
     #   unsigned long                        actual_source;                 /* A single item of SOURCE_* (optionally ORed with one SOURCE_ERROR_**/
     #   struct page*                         page;                          /* The claimed (get_page) page describing this pfn OR NULL, when the page could not be claimed */
+    #   unsigned  int                        failure_reason;                /* CLAIM_FAILURE_*, CLAIM_FAILURE_NONE if claimed */
+    #   unsigned  int                        retry_after_ms;                /* Suggested wait before requesting the frame again, or CLAIM_RETRY_NEVER */
     #};
     _fields_ = [("request", Phys_mem_frame_request),
                 ("vma_offset_of_first_byte", c_uint64),
                 ("pfn", c_uint64),
                 ("allocation_cost_jiffies", c_uint64),
                 ("actual_source", c_uint64),
-                ("page_p", c_uint64)]
+                ("page_p", c_uint64),
+                ("failure_reason", c_uint32),
+                ("retry_after_ms", c_uint32)]
     
     def __str__(self):
-       return "pfn %xd: %s, actual_source: %x vma_offset_of_first_byte:%d, page_p:%x" % (self.pfn, self.request, self.actual_source, self.vma_offset_of_first_byte, self.page_p)
+       return "pfn %xd: %s, actual_source: %x vma_offset_of_first_byte:%d, page_p:%x, failure_reason:%d, retry_after_ms:%d" % (self.pfn, self.request, self.actual_source, self.vma_offset_of_first_byte, self.page_p, self.failure_reason, self.retry_after_ms)
    
     def is_claimed(self):
         return self.page_p != 0
@@ -107,6 +181,8 @@ class Physmem:
         self.device_name = device
         self.IOCTL_CONFIGURE = 0x40184b00
         self.IOCTL_MARK_PFN_BAD = 0x40104b01
+        self.IOCTL_SET_LAYOUT = 0x40184b02
+        self.IOCTL_PAGE_STATE = 0x40204b03
         self.f = None
 
     def __del__(self):
@@ -122,19 +198,42 @@ class Physmem:
         return self.f
 
     def mark_pfn_bad(self, bad_pfn):
-            protocol_version = 1
+            protocol_version = 2
             request = Mark_page_poison(protocol_version,bad_pfn)
             #preq =   cast(request, POINTER(Mark_page_poison))
 
             rv = fcntl.ioctl(self.dev(),self.IOCTL_MARK_PFN_BAD, request )
             return rv
         
+    def set_layout(self, layout, base_pfn = 0):
+            """
+            Select the layout (LAYOUT_*) used by the next configure()
+            """
+            protocol_version = 2
+            request = Phys_mem_layout(protocol_version, layout, base_pfn)
+
+            rv = fcntl.ioctl(self.dev(),self.IOCTL_SET_LAYOUT, request )
+            return rv
+
+    def page_state(self, start_pfn, num_pfns):
+            """
+            Returns the state of the frames start_pfn..start_pfn+num_pfns-1
+            as an array of Phys_mem_page_state, indexed by pfn - start_pfn.
+            """
+            protocol_version = 2
+
+            states = (Phys_mem_page_state * num_pfns)()
+            request = Phys_mem_page_state_request(protocol_version, start_pfn, num_pfns, cast(states, POINTER(Phys_mem_page_state)))
+
+            fcntl.ioctl(self.dev(),self.IOCTL_PAGE_STATE, request )
+            return states
+
     def configure(self, requested_pfns):
             """
             Expects a list of Phys_mem_frame_request instances
             """
                 # IOCTL: 
-            protocol_version = 1
+            protocol_version = 2
             
             if    (not requested_pfns) \
                or (len(requested_pfns) == 0):
@@ -178,10 +277,14 @@ class Physmem:
                 eof = True
         return ret
 
-    def mmap(self, length):
+    def mmap(self, length, offset = 0):
+        """
+        Map the frames placed at offset..offset+length-1 (offset is page
+        aligned). Index 0 of the returned map is `offset` of the layout.
+        """
         fileno = self.dev().fileno()
         #map = mmap.mmap(fileno,4096, mmap.MAP_SHARED, mmap.PROT_READ | mmap.PROT_WRITE)
-        map = mmap.mmap(fileno, length, mmap.MAP_SHARED, mmap.PROT_READ | mmap.PROT_WRITE)
+        map = mmap.mmap(fileno, length, mmap.MAP_SHARED, mmap.PROT_READ | mmap.PROT_WRITE, offset = offset)
         wrapped = mmapwrapper.MmapWrapper(map)
         
         return wrapped
\ No newline at end of file
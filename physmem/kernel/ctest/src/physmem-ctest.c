@@ -24,7 +24,7 @@ int main(int argc, char* argv[])
 /*
   struct phys_mem_request r;
   r.num_requests=0;
-  r.protocol_version=1;
+  r.protocol_version=2;
   r.req = NULL;
 */
 
@@ -51,6 +51,7 @@
 #include "phys_mem_int.h"           /* local definitions */
 #include "page_claiming.h"           /* local definitions */
 #include "mmap_phys.h"
+#include "page_state.h"
 
 /*
  * Open and close
@@ -76,6 +77,9 @@ int phys_mem_open(struct inode *inode, struct file *filp) {
     session->vmas = 0;
     session->num_frame_stati = 0;
     session->frame_stati = NULL;
+    session->layout = PHYS_MEM_LAYOUT_DENSE;
+    session->layout_base_pfn = 0;
+    session->vma_size = 0;
     session->status.state = SESSION_STATE_INVALID;
 
     SET_STATE(session, SESSION_STATE_OPEN);
@@ -261,6 +265,39 @@ int file_ioctl_open(struct inode *inode, struct file *filp,
             }
             break;
         }
+        case PHYS_MEM_IOC_SET_LAYOUT:
+        {
+            /*  arg points to the struct phys_mem_layout */
+            struct phys_mem_layout request;
+
+            if (copy_from_user(&request, (struct phys_mem_layout __user *) arg, sizeof (struct phys_mem_layout))) {
+                printk(KERN_DEBUG "Session %llu: file_ioctl_open: copy_from_user failed. \n", session->session_id);
+                ret = -EFAULT;
+            } else {
+                printk(KERN_DEBUG "Session %llu: request: Ver %lu,  layout: %lu base pfn: %lu  \n", session->session_id, request.protocol_version, request.layout, request.base_pfn);
+                if (request.protocol_version != IOCTL_REQUEST_VERSION)
+                    ret = -EINVAL;
+                else
+                    ret = handle_set_layout(session, &request);
+            }
+            break;
+        }
+        case PHYS_MEM_IOC_PAGE_STATE:
+        {
+            /*  arg points to the struct phys_mem_page_state_request */
+            struct phys_mem_page_state_request request;
+
+            if (copy_from_user(&request, (struct phys_mem_page_state_request __user *) arg, sizeof (struct phys_mem_page_state_request))) {
+                printk(KERN_DEBUG "Session %llu: file_ioctl_open: copy_from_user failed. \n", session->session_id);
+                ret = -EFAULT;
+            } else {
+                if (request.protocol_version != IOCTL_REQUEST_VERSION)
+                    ret = -EINVAL;
+                else
+                    ret = handle_page_state(session, &request);
+            }
+            break;
+        }
 
 
         default: /* redundant, as cmd was checked against MAXNR */
@@ -0,0 +1,58 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * Allocation latency probe.
+ *
+ * Samples the latency of the page allocations of the whole system
+ * (__alloc_pages_nodemask() via a kretprobe) and sorts each sample into
+ * log2(ns) histograms depending on the claimer sections (claim_stats.h)
+ * that ran concurrently:
+ *
+ *   alloc_idle            no claimer section was active
+ *   alloc_tester          at least one claimer section was active
+ *   alloc_during_<name>   the section <name> was active
+ *
+ * A section counts as concurrent if it was active when the allocation
+ * started or returned, or has been entered in between. Allocations made by
+ * a task inside a claimer section (e.g. the spare pool's kzalloc, the
+ * migration targets of soft_offline_page()) are the tester's own and are
+ * not sampled. Comparing
+ * alloc_during_<name> with alloc_idle shows what each section costs the
+ * production allocations: zone_lock, lru_lock and pageblock_isolation are
+ * held by the free buddy claimer, hwpoison_soft_offline migrates the page
+ * content for the hwpoison claimer.
+ *
+ * The kmem:mm_page_alloc tracepoint fires only after the allocation and has
+ * no start time, so it cannot measure latency; a kretprobe can.
+ *
+ * The probe adds overhead to every allocation and is disabled by default:
+ *
+ *   insmod phys_mem.ko alloc_probe=1
+ *   cat /sys/kernel/debug/phys_mem/alloc_latency     read: histograms, write: reset
+ */
+
+#ifndef ALLOC_PROBE_H_
+#define ALLOC_PROBE_H_
+
+/**
+ * Register/unregister the probe. Called from module init/exit.
+ */
+int alloc_probe_init(void);
+void alloc_probe_exit(void);
+
+#endif /* ALLOC_PROBE_H_ */
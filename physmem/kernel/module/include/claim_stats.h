@@ -0,0 +1,147 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * Duration histograms for the critical sections of the page claimers.
+ *
+ * Claiming a page holds locks that the production allocator needs as well
+ * (zone->lock, zone->lru_lock) and isolates pageblocks. Each of these
+ * sections is timed and sorted into a log2(ns) histogram. The histograms
+ * are exported via debugfs:
+ *
+ *   /sys/kernel/debug/phys_mem/lock_stats       read: histograms, write: reset
+ *   /sys/kernel/debug/phys_mem/claim_benchmark  write N: reset the histograms
+ *                                               and claim/release N free buddy
+ *                                               pages in a synthetic loop
+ *   /sys/kernel/debug/phys_mem/claim_costs      read: cost per claimer, write:
+ *                                               reset
+ *
+ * Usage:
+ *
+ *   u64 start = claim_stats_enter(CLAIM_SECTION_ZONE_LOCK);
+ *   spin_lock(&zone->lock);
+ *   ...
+ *   spin_unlock(&zone->lock);
+ *   claim_stats_end(CLAIM_SECTION_ZONE_LOCK, start);
+ *
+ * Besides timing the section, enter/end track which sections are currently
+ * active (claim_activities) and which tasks are inside a section. The
+ * allocation latency probe (alloc_probe.h) uses this to attribute slow
+ * allocations to the tester, and to ignore the allocations of the claimers
+ * themselves.
+ */
+
+#ifndef CLAIM_STATS_H_
+#define CLAIM_STATS_H_
+
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <asm/atomic.h>
+
+/* Bucket i counts durations in [2^(i-1), 2^i) ns, the last bucket is open ended (>= 2^22 ns, ~4.2ms) */
+#define CLAIM_STATS_BUCKETS 24
+
+enum claim_section {
+    CLAIM_SECTION_ZONE_LOCK,            /* zone->lock held by the free buddy claimer */
+    CLAIM_SECTION_LRU_LOCK,             /* zone->lru_lock held by the free buddy claimer (zone->lock nests inside) */
+    CLAIM_SECTION_ISOLATION,            /* pageblock isolated (MIGRATE_ISOLATE) by the free buddy claimer */
+    CLAIM_SECTION_HWPOISON_OFFLINE,     /* soft_offline_page() (page lock, isolation, migration) */
+    CLAIM_SECTION_HWPOISON_UNPOISON,    /* unpoison_memory() */
+
+    CLAIM_NUM_SECTIONS
+};
+
+struct claim_histogram {
+    const char*     name;
+    atomic_long_t   buckets[CLAIM_STATS_BUCKETS];
+    atomic_long_t   count;
+    atomic64_t      total_ns;
+    unsigned long   max_ns;     /* updated racy, good enough for a statistic */
+};
+
+extern struct claim_histogram claim_histograms[CLAIM_NUM_SECTIONS];
+
+/*
+ * Activity of a section: the number of CPUs currently inside the section,
+ * and the number of times the section has been entered so far.
+ */
+struct claim_activity {
+    atomic_t        active;
+    atomic_long_t   entered;
+};
+
+extern struct claim_activity claim_activities[CLAIM_NUM_SECTIONS];
+
+/*
+ * Tasks inside a claimer section (sections nest, e.g. zone_lock in
+ * lru_lock). Only the first CLAIM_MAX_TASKS concurrent tasks are tracked.
+ */
+#define CLAIM_MAX_TASKS 64
+
+void claim_stats_task_enter(void);
+void claim_stats_task_exit(void);
+
+/**
+ * True if `task` is currently inside a claimer section
+ */
+int claim_stats_in_claimer(struct task_struct* task);
+
+/*
+ * The cost of a claimer, one per entry of try_claim_methods (page_claiming.c).
+ * A call is an attempt if the claimer looked at the frame: it claimed it,
+ * aborted, or reported a failure reason. Calls that only pass the frame on
+ * (e.g. source not allowed) are not counted.
+ */
+struct claim_cost {
+    const char*     name;
+    atomic_long_t   attempts;
+    atomic_long_t   claimed;
+    atomic64_t      total_ns;
+};
+
+extern struct claim_cost claim_costs[];
+
+void claim_stats_record(struct claim_histogram* histogram, u64 duration_ns);
+void claim_stats_reset_histogram(struct claim_histogram* histogram);
+
+struct seq_file;
+void claim_stats_show_histogram(struct seq_file* m, struct claim_histogram* histogram);
+
+static inline u64 claim_stats_start(void) {
+    return ktime_to_ns(ktime_get());
+}
+
+static inline u64 claim_stats_enter(enum claim_section section) {
+    claim_stats_task_enter();
+    atomic_inc(&claim_activities[section].active);
+    atomic_long_inc(&claim_activities[section].entered);
+    return claim_stats_start();
+}
+
+static inline void claim_stats_end(enum claim_section section, u64 start_ns) {
+    claim_stats_record(&claim_histograms[section], claim_stats_start() - start_ns);
+    atomic_dec(&claim_activities[section].active);
+    claim_stats_task_exit();
+}
+
+/**
+ * Create/remove the debugfs entries. Called from module init/exit.
+ */
+int claim_stats_init(void);
+void claim_stats_exit(void);
+
+#endif /* CLAIM_STATS_H_ */
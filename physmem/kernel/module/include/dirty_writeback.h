@@ -0,0 +1,86 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * Claiming dirty page-cache pages.
+ *
+ * The hwpoison claimer only takes clean page-cache pages: migrating a dirty
+ * page would migrate the dirty state with it, and soft_offline_page() does
+ * not write pages back. On write-heavy hosts a large, constantly changing
+ * part of the page cache is therefore never tested.
+ *
+ * try_claim_dirty_page_cache() (SOURCE_DIRTY_PAGE_CACHE) targets these pages:
+ *
+ *   1) A requested dirty page is queued for writeback and not claimed
+ *      (CLAIM_FAILURE_BUSY). Pages under writeback are not claimed either.
+ *   2) At the end of each Request-Pages command the queued pages are sorted
+ *      by file and index, merged into ranges and written back from a work
+ *      item: filemap_fdatawrite_range() for all ranges of the batch first,
+ *      then filemap_fdatawait_range(). The request itself does not wait.
+ *   3) When the page is requested again (after the retry hint) it is clean
+ *      and claimed through the clean page-cache path of the hwpoison
+ *      claimer. Only pages queued by this claimer are claimed (remembered
+ *      by pfn, mapping and index, at most DIRTY_WRITEBACK_MAX_TRACKED);
+ *      other clean pages are left to the hwpoison claimer.
+ *
+ * The writeback runs on a dedicated single-threaded workqueue, not on the
+ * shared keventd: the work item waits for the I/O.
+ *
+ * The I/O is bounded: at most dirty_writeback_max_inflight pages are queued
+ * or under writeback on behalf of the module; further dirty pages are not
+ * queued (but reported as busy).
+ *
+ * Module parameters (/sys/module/phys_mem/parameters):
+ *
+ *   dirty_writeback_max_inflight   Maximum number of pages queued or under
+ *                                  writeback (0 disables the writeback)
+ *
+ * Statistics: /sys/kernel/debug/phys_mem/dirty_writeback (read: statistics,
+ * write: reset)
+ */
+
+#ifndef DIRTY_WRITEBACK_H_
+#define DIRTY_WRITEBACK_H_
+
+#include <linux/mm.h>
+
+/* Pages queued per Request-Pages command */
+#define DIRTY_WRITEBACK_MAX_BATCH       512
+
+/* Queued pages remembered for the claim after the writeback */
+#define DIRTY_WRITEBACK_MAX_TRACKED     16384
+
+/**
+ * A try_claim_method: queues dirty page-cache pages for writeback and claims
+ * clean ones (SOURCE_DIRTY_PAGE_CACHE).
+ */
+int try_claim_dirty_page_cache(struct page* requested_page, unsigned int allowed_sources, struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason);
+
+/**
+ * Start the writeback of the queued pages. Called at the end of each
+ * Request-Pages command.
+ */
+void dirty_writeback_submit(void);
+
+/**
+ * Called from module init/exit. dirty_writeback_exit() waits for the
+ * writeback in flight and destroys the workqueue.
+ */
+int dirty_writeback_init(void);
+void dirty_writeback_exit(void);
+
+#endif /* DIRTY_WRITEBACK_H_ */
@@ -0,0 +1,65 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * Read-only verification of free memory.
+ *
+ * With page poisoning (CONFIG_PAGE_POISONING) the kernel fills every page it
+ * frees with PAGE_POISON (0xaa) and flags it (PAGE_DEBUG_FLAG_POISON). Every
+ * poisoned free buddy page must still contain the pattern, so free memory can
+ * be verified by just reading it: no claim, no zone->lock held while reading.
+ *
+ * The scan walks the free buddy blocks in bounded steps from a cursor. Pages
+ * that do not hold the pattern are recorded as suspects, if their block is
+ * still free after the read (otherwise the page has been allocated in the
+ * meantime and is skipped). Suspects are not proof of a defect: they are to
+ * be claimed and tested by the memory tester first.
+ *
+ * The kernel only poisons lowmem; highmem pages are not verified.
+ *
+ * Module parameters (/sys/module/phys_mem/parameters):
+ *
+ *   free_scan_pattern   Byte a free page is filled with. -1 (default) uses
+ *                       PAGE_POISON and only verifies pages flagged as
+ *                       poisoned; needs CONFIG_PAGE_POISONING. 0..255
+ *                       verifies every free lowmem page against that byte,
+ *                       for kernels that initialise pages on free.
+ *
+ * /sys/kernel/debug/phys_mem/free_scan:
+ *
+ *   write "N"   verify the free pages among the next N pfns (wraps around,
+ *               at most one pass over all pfns)
+ *   write "0"   reset the cursor, the statistics and the suspects
+ *   read        statistics, then one "suspect <pfn>" line per suspect
+ */
+
+#ifndef FREE_SCAN_H_
+#define FREE_SCAN_H_
+
+/* Further suspects are counted, but not recorded */
+#define FREE_SCAN_MAX_SUSPECTS  1024
+
+/* The scan reschedules (and stops on a fatal signal) every this many pfns */
+#define FREE_SCAN_RESCHED_PFNS  1024
+
+/**
+ * Called from module init/exit.
+ */
+int free_scan_init(void);
+void free_scan_exit(void);
+
+#endif /* FREE_SCAN_H_ */
@@ -0,0 +1,72 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * Testing hot-added memory when it is onlined.
+ *
+ * When a memory block is onlined (memory hotplug in a VM, DIMMs that come
+ * back after maintenance) all its frames are unused. They are tested
+ * completely before they join the buddy allocator: the module registers a
+ * memory hotplug notifier and tests the frames of the block at
+ * MEM_GOING_ONLINE, when they are still reserved and mapped.
+ *
+ * The block is tested in chunks of HOTPLUG_TEST_CHUNK_PAGES frames: each
+ * pattern (all zeroes, all ones, own address, inverted address) is written
+ * to the whole chunk, the chunk is flushed out of the caches (clflush), then
+ * the whole chunk is verified. Writing and verifying are sequential streams,
+ * so the test runs at memory bandwidth, and the flush makes the verification
+ * read the DRAM, not the cache, whatever the size of the LLC. Without
+ * clflush (not x86) the verification may partly read the cache.
+ *
+ * Bad frames are marked hardware poisoned (needs CONFIG_MEMORY_FAILURE):
+ * online_pages() then does not free them into the buddy allocator, and they
+ * are reported as HWPOISON in /proc/kpageflags. Without CONFIG_MEMORY_FAILURE
+ * a block with bad frames is not onlined at all. Frames that are already
+ * poisoned and highmem frames are not tested.
+ *
+ * Module parameters (/sys/module/phys_mem/parameters):
+ *
+ *   hotplug_test           Test blocks when they are onlined (default: 1)
+ *   hotplug_test_fail_pfn  Fault injection: treat this pfn as bad when its
+ *                          block is tested (default: 0, none)
+ *
+ * /sys/kernel/debug/phys_mem/hotplug_test:
+ *
+ *   read    statistics, one "block <start pfn> <frames> ..." line per recently
+ *           tested block, then one "bad <pfn>" line per bad frame
+ *   write   reset the statistics
+ *
+ * Only available with CONFIG_MEMORY_HOTPLUG.
+ */
+
+#ifndef HOTPLUG_TEST_H_
+#define HOTPLUG_TEST_H_
+
+/* Frames written (and flushed) before they are verified */
+#define HOTPLUG_TEST_CHUNK_PAGES        2048
+
+/* Blocks and bad frames listed in debugfs. Further bad frames are counted, but not recorded */
+#define HOTPLUG_TEST_MAX_BLOCKS         64
+#define HOTPLUG_TEST_MAX_BAD            1024
+
+/**
+ * Register/unregister the memory hotplug notifier. Called from module init/exit.
+ */
+int hotplug_test_init(void);
+void hotplug_test_exit(void);
+
+#endif /* HOTPLUG_TEST_H_ */
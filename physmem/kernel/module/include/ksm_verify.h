@@ -0,0 +1,67 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * Read-only verification of KSM-merged pages.
+ *
+ * A stable KSM page is shared write-protected by all processes that merged
+ * it; a write breaks COW onto a new page. Its content therefore never
+ * changes while it stays the same stable page, and that content can be
+ * verified without claiming or migrating anything: the verifier checksums
+ * each stable page once, and rechecks it at a low rate. A page whose
+ * checksum changed while it stayed merged is reported (printk and debugfs).
+ *
+ * The identity of a stable page is its pfn, its stable node (page->mapping)
+ * and page->index: stable nodes are freed and reused, the index tells a page
+ * merged anew at the same pfn apart. A page that left the stable tree is
+ * forgotten, a page that became another stable page is checksummed anew.
+ * Pages are pinned and checked for KSM before and after they are read, and
+ * a mismatch is read a second time before it is reported.
+ *
+ * The checksum is crc32c (libcrc32c), which uses the CRC32 instruction of
+ * SSE4.2 (crc32c-intel) where available.
+ *
+ * A delayed work item walks the pfns from a cursor, checksumming at most
+ * ksm_verify_batch pages per run.
+ *
+ * Module parameters (/sys/module/phys_mem/parameters):
+ *
+ *   ksm_verify_interval_ms   Pause between two runs (0: paused)
+ *   ksm_verify_batch         Pages checksummed per run
+ *   ksm_verify_max_pages     Stable pages tracked at most (48 bytes each)
+ *
+ * /sys/kernel/debug/phys_mem/ksm_verify:
+ *
+ *   write "N"   verify the stable pages among the next N pfns now (at
+ *               most one sweep of all pfns)
+ *   write "0"   forget all checksums, reset the cursor and the statistics
+ *   read        statistics, then one "changed <pfn>" line per reported page
+ */
+
+#ifndef KSM_VERIFY_H_
+#define KSM_VERIFY_H_
+
+/* Further changed pages are counted, but not recorded */
+#define KSM_VERIFY_MAX_CHANGED  1024
+
+/**
+ * Called from module init/exit.
+ */
+int ksm_verify_init(void);
+void ksm_verify_exit(void);
+
+#endif /* KSM_VERIFY_H_ */
@@ -41,6 +41,14 @@ int handle_request_pages(struct phys_mem_session*, const struct phys_mem_request
 
 int handle_mark_page_poison(struct phys_mem_session* session, const struct mark_page_poison* request);
 
+/**
+ * Implements the Set-layout command. The layout is used by the following
+ * Request-Pages commands.
+ *
+ * The function is called with the session semaphore NOT held.
+ */
+int handle_set_layout(struct phys_mem_session* session, const struct phys_mem_layout* request);
+
 #define CLAIMED_SUCCESSFULLY 1 /* The page had been claimed and all is well.*/
 #define CLAIMED_TRY_NEXT     2 /* The page could not be claimed because this function is not responsible for it. Try the next mechanism. */
 #define CLAIMED_ABORT        3 /* Abort processing, the page could not be claimed. */
@@ -51,20 +59,24 @@ int handle_mark_page_poison(struct phys_mem_session* session, const struct mark_
  * Returns CLAIMED_*
  *
  * Iff CLAIMED_SUCCESSFULLY is returned, then *actual_source should be updated.
+ *
+ * A method that is responsible for the page but cannot claim it sets
+ * *failure_reason (CLAIM_FAILURE_*). The reason of the last method that set
+ * one is reported to user space.
  */
-typedef int (*try_claim_method)(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source);
+typedef int (*try_claim_method)(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason);
 
 
-int try_claim_page_from_user_process(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source);
-int try_claim_page_in_page_cache(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source);
-int try_claim_free_page(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source);
-int try_claim_free_buddy_page(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source);
+int try_claim_page_from_user_process(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason);
+int try_claim_page_in_page_cache(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason);
+int try_claim_free_page(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason);
+int try_claim_free_buddy_page(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason);
 
-int try_claim_page_via_hwpoison(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source);
+int try_claim_page_via_hwpoison(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason);
 
-int try_any_page_claiming(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page,  unsigned long* actual_source);
+int try_any_page_claiming(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page,  unsigned long* actual_source, unsigned int* failure_reason);
 
-int ignore_difficult_pages(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source);
+int ignore_difficult_pages(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason);
 
 void my_dump_page(struct page* page, char* msg);
 
@@ -0,0 +1,31 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PAGE_STATE_H_
+#define PAGE_STATE_H_
+
+/**
+ * Implements the Page-state command (see phys_mem.h): copies one struct
+ * phys_mem_page_state per requested pfn to request->states.
+ *
+ * Takes session->sem for the duration of the copy; the session must be
+ * OPEN or CONFIGURED (else -EINVAL) and is not changed. Returns the number
+ * of records written.
+ */
+int handle_page_state(struct phys_mem_session* session, const struct phys_mem_page_state_request* request);
+
+#endif /* PAGE_STATE_H_ */
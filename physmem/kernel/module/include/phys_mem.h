@@ -56,6 +56,10 @@
  *        in the page cache or somewhere different altogether?
  *      - The first and last address of the frame in the VMA
  *        (virtual __user address)
+ *      - For frames that could not be claimed: why not (CLAIM_FAILURE_*),
+ *        and how long to wait before requesting the frame again
+ *        (retry_after_ms, CLAIM_RETRY_NEVER for frames that will not
+ *        become claimable)
  *
  *         *
  *    Example (requesting 1,2,3,10):
@@ -81,6 +85,39 @@
  * 4) mmap the region. The size of the region is 0..end of last frame. In
  *    the case depicted above: 0..16383 / 0..12287
  *    The flags O_DIRECT and O_SYNC from the Open call are used here.
+ *    The mmap offset is honoured: a mapping of length L at offset O maps
+ *    the frames placed in O..O+L-1 of the layout, so that several workers
+ *    can map disjoint slices of the same session.
+ *
+ *    The 'Set layout' IOCTL, issued before the 'Request'-IOCTL, selects
+ *    how frames are placed:
+ *      - PHYS_MEM_LAYOUT_DENSE (default): as described in step 3
+ *      - PHYS_MEM_LAYOUT_PFN_INDEXED: the frame with pfn P is placed at
+ *        (P - base_pfn) * PAGE_SIZE. Frames that could not be claimed leave
+ *        an unmapped hole (accessing it raises SIGBUS), physically
+ *        contiguous frames are virtually contiguous.
+ *
+ *    Example (PFN indexed, base_pfn 1, requesting 1,2,3,10 & the module
+ *    could not get pfn 3):
+ *
+ *    pfn  |  virtual start..end
+ *    -----+--------------------
+ *     1   |     0.. 4095
+ *     2   |  4096.. 8191
+ *    10   | 36864..40959
+ *
+ *
+ * Page state
+ * ==========
+ *
+ * The 'Page state' IOCTL fills a user buffer with one struct
+ * phys_mem_page_state per pfn of a range: the /proc/kpageflags flags, the
+ * /proc/kpagecount map count, and the buddy order, migratetype, zone and
+ * node, i.e. everything that decides whether a frame can be claimed. The
+ * records are taken under zone->lock in batches, so the fields of a record
+ * (and of the records of a batch) are consistent with each other. The IOCTL
+ * is allowed in the OPEN and CONFIGURED states and does not change the
+ * session. It returns the number of records written.
  *
  *
  * Each call to "open" creates a new session.
@@ -306,6 +343,9 @@
 #define SOURCE_HW_POISON_PAGE_CACHE          0x00040       /* Use the HW_POISON claimer */
 #define SOURCE_HW_POISON          (SOURCE_HW_POISON_ANON |  SOURCE_HW_POISON_PAGE_CACHE)
 
+#define SOURCE_DIRTY_PAGE_CACHE   0x00080       /* Write back dirty page-cache pages, then claim them like clean ones */
+#define SOURCE_SWAP_CACHE         0x00100       /* Drop clean unmapped swap-cache pages, write back dirty ones first */
+
 
 #define SOURCE_INVALID_PFN        0x80000       /* Not a source but the reply for invalid (too large) PFNs */
 
@@ -315,6 +355,26 @@
 #define SOURCE_ERROR_MASK       0xFFF00000
 
 #define PFN_IS_CLAIMED(phys_mem_frame_status) ((phys_mem_frame_status->actual_source & SOURCE_MASK) != 0)
+
+/*
+ * Why a frame could not be claimed. Reported by the claimers, the
+ * suggested retry interval is derived from the reason.
+ */
+#define CLAIM_FAILURE_NONE              0       /* Claimed */
+#define CLAIM_FAILURE_NOT_ALLOWED       1       /* No allowed source is responsible for the frame */
+#define CLAIM_FAILURE_RACE              2       /* The frame changed its state while being claimed */
+#define CLAIM_FAILURE_BUSY              3       /* Locked or under writeback: transient */
+#define CLAIM_FAILURE_IN_USE            4       /* Referenced by the kernel or a process */
+#define CLAIM_FAILURE_MIGRATION         5       /* The content could not be migrated away (soft offline) */
+#define CLAIM_FAILURE_UNMOVABLE         6       /* Slab, reserved, ..: will never be claimable */
+#define CLAIM_FAILURE_POISONED          7       /* Marked as hardware poisoned */
+#define CLAIM_FAILURE_PROTECTED         8       /* Deliberately not touched (first MB, kernel image) */
+#define CLAIM_FAILURE_INVALID_PFN       9       /* No such frame, or not placeable in the layout */
+
+#define CLAIM_FAILURE_NUM_REASONS       10
+
+#define CLAIM_RETRY_NEVER               0xFFFFFFFF      /* retry_after_ms: do not retry */
+
 /**
  * A single request for a single pfn
  */
@@ -333,10 +393,32 @@ struct phys_mem_frame_status {
    unsigned long long                                  allocation_cost_jiffies;       /* How long did it take to get a hold on this frame? Measured in jiffies*/
    unsigned  long                       actual_source;                 /* A single item of SOURCE_* (optionally ORed with one SOURCE_ERROR_**/
    struct page*                         page;                          /* The claimed (get_page) page describing this pfn OR NULL, when the page could not be claimed */
+   unsigned  int                        failure_reason;                /* CLAIM_FAILURE_*, CLAIM_FAILURE_NONE if claimed */
+   unsigned  int                        retry_after_ms;                /* Suggested wait before requesting the frame again, or CLAIM_RETRY_NEVER */
 };
 
 
 
+/**
+ * The layout of the VMA (see 'Set layout' above)
+ */
+#define PHYS_MEM_LAYOUT_DENSE           0       /* Claimed frames are packed in request order */
+#define PHYS_MEM_LAYOUT_PFN_INDEXED     1       /* A frame is placed at (pfn - base_pfn) * PAGE_SIZE */
+
+/**
+ * The state of a single pfn (see 'Page state' above). 16 bytes, packed.
+ */
+#define PHYS_MEM_PAGE_STATE_NONE        0xff    /* buddy_order: not a free block head. All: no such frame */
+
+struct phys_mem_page_state {
+   unsigned long long   flags;          /* As in /proc/kpageflags (KPF_NOPAGE if there is no frame) */
+   unsigned int         count;          /* As in /proc/kpagecount: the map count */
+   unsigned char        buddy_order;    /* Order of the free block headed by this frame or PHYS_MEM_PAGE_STATE_NONE */
+   unsigned char        migratetype;    /* MIGRATE_* of the pageblock */
+   unsigned char        zone;           /* Zone index (ZONE_DMA, ZONE_NORMAL, ..) */
+   unsigned char        node;           /* NUMA node */
+};
+
 /*
  * The different configurable parameters
  */
@@ -352,7 +434,11 @@ extern int phys_mem_qset;
  */
 
 
-#define IOCTL_REQUEST_VERSION   1
+/*
+ * Version 2: struct phys_mem_frame_status carries failure_reason and
+ * retry_after_ms (64 instead of 56 bytes). All IOCTLs check the version.
+ */
+#define IOCTL_REQUEST_VERSION   2
 
 struct phys_mem_request {
   unsigned  long protocol_version; /* The protocol/struct version of this IOCTL call. Must be IOCTL_REQUEST_VERSION */
@@ -366,6 +452,19 @@ struct mark_page_poison{
 };
 
 
+struct phys_mem_layout {
+  unsigned  long protocol_version; /* The protocol/struct version of this IOCTL call. Must be IOCTL_REQUEST_VERSION */
+  unsigned  long layout;           /* PHYS_MEM_LAYOUT_* */
+  unsigned  long base_pfn;         /* PHYS_MEM_LAYOUT_PFN_INDEXED: the pfn placed at offset 0. Smaller pfns cannot be requested */
+};
+
+struct phys_mem_page_state_request {
+  unsigned  long protocol_version; /* The protocol/struct version of this IOCTL call. Must be IOCTL_REQUEST_VERSION */
+  unsigned  long start_pfn;        /* The first pfn */
+  unsigned  long num_pfns;         /* The number of pfns */
+  struct phys_mem_page_state   *states; /* A pointer to the result array. The array must hold at least num_pfns items */
+};
+
 /* Use 'K' as magic number */
 #define PHYS_MEM_IOC_MAGIC  'K'
 
@@ -374,8 +473,10 @@ struct mark_page_poison{
  */
 #define PHYS_MEM_IOC_REQUEST_PAGES    _IOW(PHYS_MEM_IOC_MAGIC, 0, struct phys_mem_request )
 #define PHYS_MEM_IOC_MARK_FRAME_BAD    _IOW(PHYS_MEM_IOC_MAGIC, 1, struct mark_page_poison )
+#define PHYS_MEM_IOC_SET_LAYOUT    _IOW(PHYS_MEM_IOC_MAGIC, 2, struct phys_mem_layout )
+#define PHYS_MEM_IOC_PAGE_STATE    _IOW(PHYS_MEM_IOC_MAGIC, 3, struct phys_mem_page_state_request )
 
 
-#define PHYS_MEM_IOC_MAXNR 1
+#define PHYS_MEM_IOC_MAXNR 3
 
 #endif
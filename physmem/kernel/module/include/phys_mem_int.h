@@ -70,10 +70,16 @@ struct phys_mem_session {
          struct semaphore       sem;            /* Session Lock */
          unsigned long          num_frame_stati;     /* The number of frame stati in status */
          struct phys_mem_frame_status* frame_stati; /* An array with num_status items */
+         unsigned long          layout;              /* PHYS_MEM_LAYOUT_* used by the next request */
+         unsigned long          layout_base_pfn;     /* PHYS_MEM_LAYOUT_PFN_INDEXED: pfn at offset 0 */
+         unsigned long long     vma_size;            /* The size of the layout of frame_stati: the largest mmap-able offset */
 };
 
 extern struct phys_mem_dev *phys_mem_devices;
 
+/* The debugfs directory of the module (/sys/kernel/debug/phys_mem) or NULL */
+extern struct dentry *phys_mem_debugfs_dir;
+
 
 
 /*
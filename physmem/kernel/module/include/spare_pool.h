@@ -0,0 +1,73 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * Whole-block claiming and the spare pool.
+ *
+ * Claiming a single frame out of a free high-order block splits the block
+ * (expand__clone()). The block is then unavailable for huge pages as long
+ * as the frame is held, although the memory tester requests the neighbours
+ * of the frame shortly after.
+ *
+ * When the free buddy claimer would split a free block of order
+ * >= whole_block_order, it takes the complete block instead: the requested
+ * frame is returned, all other frames of the block are parked in the spare
+ * pool. Requests for parked frames are served from the pool
+ * (try_claim_spare_page() is the first claimer). Parked frames that have not
+ * been requested within spare_pool_timeout_ms are given back to the buddy
+ * allocator, where they merge into the original block again as soon as the
+ * claimed frames are released. The pool is emptied on module unload.
+ *
+ * Module parameters (/sys/module/phys_mem/parameters):
+ *
+ *   whole_block_order       Minimum order of a free block that is claimed as
+ *                           a whole. 0 disables whole-block claiming. Orders
+ *                           >= MAX_ORDER are rejected (-EINVAL).
+ *   spare_pool_timeout_ms   How long frames stay parked.
+ *
+ * Statistics: /sys/kernel/debug/phys_mem/spare_pool
+ */
+
+#ifndef SPARE_POOL_H_
+#define SPARE_POOL_H_
+
+#include <linux/mm.h>
+
+extern int whole_block_order;
+
+/**
+ * Park all frames of the block head..head + 2^order - 1 except `claimed`
+ * and the frames whose bit (relative to head) is set in `bad`. Bad frames
+ * failed prep_new_page() and are leaked. All other frames must be
+ * refcounted (page_count == 1) and owned by the caller.
+ *
+ * If the pool cannot take the block, the spare frames are freed immediately.
+ */
+void spare_pool_add_block(struct page* head, unsigned int order, struct page* claimed, const unsigned long* bad);
+
+/**
+ * A try_claim_method: hands out parked frames (SOURCE_FREE_BUDDY_PAGE).
+ */
+int try_claim_spare_page(struct page* requested_page, unsigned int allowed_sources, struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason);
+
+/**
+ * Called from module init/exit. spare_pool_exit() releases all parked frames.
+ */
+int spare_pool_init(void);
+void spare_pool_exit(void);
+
+#endif /* SPARE_POOL_H_ */
@@ -0,0 +1,83 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * Claiming swap-cache pages.
+ *
+ * On hosts under memory pressure many frames hold swap-cache pages: pages
+ * that have been swapped out but are still cached, or swapped in but no
+ * longer mapped. try_claim_swap_cache_page() (SOURCE_SWAP_CACHE) claims the
+ * unmapped ones:
+ *
+ *   clean  The swap copy is current, so the page is dropped from the swap
+ *          cache (like reclaim does: refs frozen under the swap cache tree
+ *          lock) and claimed. A later swap-in reads the swap copy.
+ *   dirty  The swap copy is stale. The page is queued for writeback and not
+ *          claimed (CLAIM_FAILURE_BUSY). At the end of each Request-Pages
+ *          command the queued pages are sorted by swap slot and written by
+ *          a work item (swap_writepage()) on a dedicated single-threaded
+ *          workqueue, not on the shared keventd: the work item waits for
+ *          the I/O. When the page is requested again it is clean.
+ *
+ * Mapped swap-cache pages are in use (CLAIM_FAILURE_IN_USE); the hwpoison
+ * claimer can migrate them away with SOURCE_HW_POISON_ANON.
+ *
+ * Module parameters (/sys/module/phys_mem/parameters):
+ *
+ *   swap_writeback_max_inflight    Maximum number of pages queued or under
+ *                                  writeback (0 disables the writeback)
+ *
+ * Statistics: /sys/kernel/debug/phys_mem/swap_cache (read: statistics,
+ * write: reset). Whether this source is worth it compared to the others
+ * shows in claim_costs (claim_stats.h).
+ */
+
+#ifndef SWAP_CACHE_H_
+#define SWAP_CACHE_H_
+
+#include <linux/mm.h>
+
+/* Pages queued per Request-Pages command */
+#define SWAP_WRITEBACK_MAX_BATCH        256
+
+/*
+ * in mm/vmscan.c, declared in mm/internal.h only. The declarations of
+ * hwpoison/internal.h are compiled with the hwpoison clone only.
+ */
+extern int isolate_lru_page(struct page *page);
+extern void putback_lru_page(struct page *page);
+
+/**
+ * A try_claim_method: claims clean and queues dirty unmapped swap-cache
+ * pages (SOURCE_SWAP_CACHE).
+ */
+int try_claim_swap_cache_page(struct page* requested_page, unsigned int allowed_sources, struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason);
+
+/**
+ * Start the writeback of the queued pages. Called at the end of each
+ * Request-Pages command.
+ */
+void swap_writeback_submit(void);
+
+/**
+ * Called from module init/exit. swap_cache_exit() waits for the writeback
+ * in flight and destroys the workqueue.
+ */
+int swap_cache_init(void);
+void swap_cache_exit(void);
+
+#endif /* SWAP_CACHE_H_ */
@@ -52,8 +52,17 @@
 #include <asm/uaccess.h>
 #include <linux/mm.h>
 #include <linux/device.h>
+#include <linux/debugfs.h>
 
 #include "phys_mem_int.h"           /* local definitions */
+#include "claim_stats.h"
+#include "spare_pool.h"
+#include "alloc_probe.h"
+#include "free_scan.h"
+#include "hotplug_test.h"
+#include "dirty_writeback.h"
+#include "swap_cache.h"
+#include "ksm_verify.h"
 
 
 int phys_mem_major = PHYS_MEM_MAJOR;
@@ -63,6 +72,8 @@ static struct class *device_class;
 
 struct phys_mem_dev *phys_mem_devices; /* allocated in phys_mem_init */
 
+struct dentry *phys_mem_debugfs_dir; /* /sys/kernel/debug/phys_mem, NULL without debugfs */
+
 void phys_mem_cleanup(void);
 
 
@@ -104,6 +115,7 @@ void free_page_stati(struct phys_mem_session* session) {
     }
     session->num_frame_stati = 0;
     session->frame_stati = NULL;
+    session->vma_size = 0;
 }
 
 static void phys_mem_setup_cdev(struct phys_mem_dev *dev, int index) {
@@ -171,6 +183,23 @@ int phys_mem_init(void) {
 
 
 
+    phys_mem_debugfs_dir = debugfs_create_dir(CHAR_DEVICE_NAME, NULL);
+    if (IS_ERR(phys_mem_debugfs_dir))
+        phys_mem_debugfs_dir = NULL;
+
+    if (!phys_mem_debugfs_dir)
+        printk(KERN_WARNING "no debugfs support: claim statistics are not available\n");
+    else if (claim_stats_init())
+        printk(KERN_WARNING "Could not create the claim statistics in debugfs\n");
+
+    spare_pool_init();
+    alloc_probe_init();
+    free_scan_init();
+    hotplug_test_init();
+    dirty_writeback_init();
+    swap_cache_init();
+    ksm_verify_init();
+
     PRINT_SIZE(void*);
     PRINT_SIZE(short);
     PRINT_SIZE(int);
@@ -195,6 +224,21 @@ fail_malloc:
 void phys_mem_cleanup(void) {
     int i;
 
+    /* Before debugfs: remove their files */
+    ksm_verify_exit();
+    swap_cache_exit();
+    dirty_writeback_exit();
+    hotplug_test_exit();
+    free_scan_exit();
+    alloc_probe_exit();
+    spare_pool_exit();
+
+    if (phys_mem_debugfs_dir) {
+        claim_stats_exit();
+        debugfs_remove_recursive(phys_mem_debugfs_dir);
+        phys_mem_debugfs_dir = NULL;
+    }
+
     if (!IS_ERR(device_class)) {
         for (i = 0; i < phys_mem_devs; i++) {
             device_destroy(device_class, MKDEV(phys_mem_major, i));
@@ -69,21 +69,42 @@ void phys_mem_vma_close(struct vm_area_struct *vma)
   up(&session->sem);
 }
 
+/*
+ * All frames are inserted by assemble_vma(), so a fault can only hit a hole
+ * of the layout (a frame that has not been claimed). Without a fault handler
+ * the kernel would silently map a private anonymous page there.
+ */
+static int phys_mem_vma_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+  return VM_FAULT_SIGBUS;
+}
+
 struct vm_operations_struct phys_mem_vm_ops = {
 	.open =     phys_mem_vma_open,
 	.close =    phys_mem_vma_close,
+	.fault =    phys_mem_vma_fault,
 };
 
 
+/*
+ * Insert all frames placed in the window vm_pgoff..vm_pgoff + size of the
+ * layout into the vma. Offsets outside of the window belong to other
+ * mappings, holes in the layout stay unmapped.
+ */
 int assemble_vma (struct phys_mem_session* session, struct vm_area_struct * vma){
   unsigned long request_iterator;
   int insert_status = 0;
+  unsigned long long window_start = ((unsigned long long) vma->vm_pgoff) << PAGE_SHIFT;
+  unsigned long long window_end = window_start + (vma->vm_end - vma->vm_start);
 
   for (request_iterator = 0; request_iterator < session->num_frame_stati; request_iterator++){
     struct phys_mem_frame_status* frame_status = &session->frame_stati[request_iterator];
 
-    if ( frame_status->page) {
-      insert_status  = vm_insert_page(vma,vma->vm_start + frame_status->vma_offset_of_first_byte, frame_status->page);
+    if ( frame_status->page && !(frame_status->actual_source & SOURCE_ERROR_NOT_MAPPABLE)) {
+      if (frame_status->vma_offset_of_first_byte < window_start || frame_status->vma_offset_of_first_byte >= window_end)
+        continue;
+
+      insert_status  = vm_insert_page(vma,vma->vm_start + (unsigned long) (frame_status->vma_offset_of_first_byte - window_start), frame_status->page);
 
       if  (unlikely(insert_status)){
         /* Upps! We could not insert our page. This should not really happen, so we just print that
@@ -105,7 +126,7 @@ int file_mmap_configured(struct file * filp, struct vm_area_struct * vma){
    struct phys_mem_session* session = (struct phys_mem_session*) filp->private_data;
    int ret = 0;
 
-   unsigned long  max_size;
+   unsigned long long  window_end;
 
 
     if (down_interruptible (&session->sem))
@@ -118,12 +139,12 @@ int file_mmap_configured(struct file * filp, struct vm_area_struct * vma){
       goto err;
     }
 
-    max_size = ROUND_UP_TO_PAGE(SESSION_FRAME_STATI_SIZE(session->num_frame_stati));
-    max_size <<= PAGE_SHIFT;
+    /* The mapping must lie within the layout of the frames */
+    window_end = (((unsigned long long) vma->vm_pgoff) << PAGE_SHIFT) + (vma->vm_end - vma->vm_start);
 
-    if ( vma->vm_end - vma->vm_start > max_size){
+    if ( window_end > ROUND_UP_TO_PAGE(session->vma_size)){
       ret = -EINVAL;
-      printk(KERN_NOTICE "Mmap too large:  %lx > %lx", vma->vm_end - vma->vm_start, max_size );
+      printk(KERN_NOTICE "Mmap too large:  offset %lx + size %lx > %llx", vma->vm_pgoff << PAGE_SHIFT, vma->vm_end - vma->vm_start, session->vma_size );
       goto err;
     }
 
@@ -0,0 +1,214 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Sample the allocator latency and attribute it to concurrent claimer sections.
+ *
+ * See alloc_probe.h for a complete documentation!
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel.h>       /* printk() */
+#include <linux/errno.h>        /* error codes */
+#include <linux/kprobes.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include "phys_mem.h"           /* local definitions */
+#include "phys_mem_int.h"           /* local definitions */
+#include "claim_stats.h"           /* local definitions */
+#include "alloc_probe.h"           /* local definitions */
+
+static int alloc_probe;
+module_param(alloc_probe, bool, S_IRUGO);
+MODULE_PARM_DESC(alloc_probe, "Sample the latency of all page allocations and attribute it to concurrent claims (see debugfs alloc_latency)");
+
+#ifdef CONFIG_KRETPROBES
+
+static struct claim_histogram alloc_idle = {.name = "alloc_idle"};
+static struct claim_histogram alloc_tester = {.name = "alloc_tester"};
+
+static struct claim_histogram alloc_during[CLAIM_NUM_SECTIONS] = {
+    [CLAIM_SECTION_ZONE_LOCK] = {.name = "alloc_during_zone_lock"},
+    [CLAIM_SECTION_LRU_LOCK] = {.name = "alloc_during_lru_lock"},
+    [CLAIM_SECTION_ISOLATION] = {.name = "alloc_during_pageblock_isolation"},
+    [CLAIM_SECTION_HWPOISON_OFFLINE] = {.name = "alloc_during_hwpoison_soft_offline"},
+    [CLAIM_SECTION_HWPOISON_UNPOISON] = {.name = "alloc_during_hwpoison_unpoison"},
+};
+
+/* Allocations made by a task inside a claimer section, not sampled */
+static atomic_long_t alloc_skipped = ATOMIC_LONG_INIT(0);
+
+/* Per allocation in flight (kretprobe_instance.data) */
+struct alloc_sample {
+    u64 start_ns;
+    unsigned int active_mask;                       /* bit i: section i active at the start */
+    unsigned long entered[CLAIM_NUM_SECTIONS];      /* claim_activities[i].entered at the start */
+};
+
+static int alloc_entry(struct kretprobe_instance* ri, struct pt_regs* regs) {
+    struct alloc_sample* sample = (struct alloc_sample*) ri->data;
+    int section;
+
+    /*
+     * Allocations of the claimers themselves (e.g. the spare pool's kzalloc,
+     * migration targets of soft_offline_page()) are not production
+     * allocations: a non-zero return skips the return handler.
+     */
+    if (claim_stats_in_claimer(current)) {
+        atomic_long_inc(&alloc_skipped);
+        return 1;
+    }
+
+    sample->active_mask = 0;
+    for (section = 0; section < CLAIM_NUM_SECTIONS; section++) {
+        if (atomic_read(&claim_activities[section].active))
+            sample->active_mask |= 1 << section;
+        sample->entered[section] = atomic_long_read(&claim_activities[section].entered);
+    }
+
+    sample->start_ns = claim_stats_start();
+    return 0;
+}
+
+static int alloc_return(struct kretprobe_instance* ri, struct pt_regs* regs) {
+    struct alloc_sample* sample = (struct alloc_sample*) ri->data;
+    u64 duration_ns = claim_stats_start() - sample->start_ns;
+    unsigned int concurrent = sample->active_mask;
+    int section;
+
+    for (section = 0; section < CLAIM_NUM_SECTIONS; section++) {
+        if (atomic_read(&claim_activities[section].active) ||
+                atomic_long_read(&claim_activities[section].entered) != sample->entered[section])
+            concurrent |= 1 << section;
+    }
+
+    if (!concurrent) {
+        claim_stats_record(&alloc_idle, duration_ns);
+        return 0;
+    }
+
+    claim_stats_record(&alloc_tester, duration_ns);
+    for (section = 0; section < CLAIM_NUM_SECTIONS; section++) {
+        if (concurrent & (1 << section))
+            claim_stats_record(&alloc_during[section], duration_ns);
+    }
+    return 0;
+}
+
+static struct kretprobe alloc_kretprobe = {
+    .kp.symbol_name = "__alloc_pages_nodemask",
+    .entry_handler = alloc_entry,
+    .handler = alloc_return,
+    .data_size = sizeof (struct alloc_sample),
+    /* Allocations can sleep in direct reclaim: allow plenty in flight */
+    .maxactive = 256,
+};
+
+static int alloc_probe_registered;
+static struct dentry* alloc_latency_file;
+
+static int alloc_latency_show(struct seq_file* m, void* v) {
+    int section;
+
+    seq_printf(m, "missed samples: %d\n", alloc_kretprobe.nmissed);
+    seq_printf(m, "skipped claimer allocations: %ld\n", atomic_long_read(&alloc_skipped));
+    claim_stats_show_histogram(m, &alloc_idle);
+    claim_stats_show_histogram(m, &alloc_tester);
+
+    for (section = 0; section < CLAIM_NUM_SECTIONS; section++)
+        claim_stats_show_histogram(m, &alloc_during[section]);
+
+    return 0;
+}
+
+static int alloc_latency_open(struct inode* inode, struct file* file) {
+    return single_open(file, alloc_latency_show, NULL);
+}
+
+static ssize_t alloc_latency_write(struct file* file, const char __user* buf, size_t count, loff_t* ppos) {
+    int section;
+
+    atomic_long_set(&alloc_skipped, 0);
+    claim_stats_reset_histogram(&alloc_idle);
+    claim_stats_reset_histogram(&alloc_tester);
+    for (section = 0; section < CLAIM_NUM_SECTIONS; section++)
+        claim_stats_reset_histogram(&alloc_during[section]);
+
+    return count;
+}
+
+static const struct file_operations alloc_latency_fops = {
+    .owner = THIS_MODULE,
+    .open = alloc_latency_open,
+    .read = seq_read,
+    .write = alloc_latency_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+int alloc_probe_init(void) {
+    int ret;
+
+    if (!alloc_probe)
+        return 0;
+
+    if (!phys_mem_debugfs_dir) {
+        printk(KERN_WARNING "alloc_probe: no debugfs, the allocation latency probe is disabled\n");
+        return -ENODEV;
+    }
+
+    ret = register_kretprobe(&alloc_kretprobe);
+    if (ret) {
+        printk(KERN_WARNING "alloc_probe: could not probe %s: %i\n", alloc_kretprobe.kp.symbol_name, ret);
+        return ret;
+    }
+    alloc_probe_registered = 1;
+
+    alloc_latency_file = debugfs_create_file("alloc_latency", S_IRUSR | S_IWUSR, phys_mem_debugfs_dir, NULL, &alloc_latency_fops);
+    if (!alloc_latency_file) {
+        alloc_probe_exit();
+        return -ENOMEM;
+    }
+
+    printk(KERN_NOTICE "alloc_probe: sampling the latency of %s\n", alloc_kretprobe.kp.symbol_name);
+    return 0;
+}
+
+void alloc_probe_exit(void) {
+    if (alloc_probe_registered) {
+        unregister_kretprobe(&alloc_kretprobe);
+        alloc_probe_registered = 0;
+    }
+
+    debugfs_remove(alloc_latency_file);
+    alloc_latency_file = NULL;
+}
+
+#else /* CONFIG_KRETPROBES */
+
+int alloc_probe_init(void) {
+    if (alloc_probe)
+        printk(KERN_WARNING "alloc_probe: the kernel has no kretprobes (CONFIG_KRETPROBES), the allocation latency probe is disabled\n");
+    return 0;
+}
+
+void alloc_probe_exit(void) {
+}
+
+#endif /* CONFIG_KRETPROBES */
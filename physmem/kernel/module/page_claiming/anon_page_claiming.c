@@ -43,7 +43,7 @@
 /**
  * Try to claim page from a (user) process
  */
-int try_claim_page_from_user_process(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source) {
+int try_claim_page_from_user_process(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason) {
   int ret = CLAIMED_TRY_NEXT;
 
   if ( allowed_sources & SOURCE_ANONYMOUS) {
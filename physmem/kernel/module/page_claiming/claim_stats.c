@@ -0,0 +1,359 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Lock-hold and isolation histograms of the claimers, and a synthetic claim
+ * loop to measure them in a VM.
+ *
+ * See claim_stats.h for a complete documentation!
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>       /* printk() */
+#include <linux/errno.h>        /* error codes */
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/sched.h>        /* cond_resched() */
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <asm/uaccess.h>
+
+#include "phys_mem.h"           /* local definitions */
+#include "phys_mem_int.h"           /* local definitions */
+#include "page_claiming.h"           /* local definitions */
+#include "claim_stats.h"           /* local definitions */
+
+struct claim_histogram claim_histograms[CLAIM_NUM_SECTIONS] = {
+    [CLAIM_SECTION_ZONE_LOCK] = {.name = "zone_lock"},
+    [CLAIM_SECTION_LRU_LOCK] = {.name = "lru_lock"},
+    [CLAIM_SECTION_ISOLATION] = {.name = "pageblock_isolation"},
+    [CLAIM_SECTION_HWPOISON_OFFLINE] = {.name = "hwpoison_soft_offline"},
+    [CLAIM_SECTION_HWPOISON_UNPOISON] = {.name = "hwpoison_unpoison"},
+};
+
+struct claim_activity claim_activities[CLAIM_NUM_SECTIONS];
+
+/*
+ * The tasks inside a claimer section. A slot is taken with cmpxchg and
+ * only changed by its task afterwards, so `depth` needs no lock.
+ */
+struct claim_task {
+    struct task_struct* task;
+    int depth;
+};
+
+static struct claim_task claim_tasks[CLAIM_MAX_TASKS];
+static atomic_t claim_tasks_active = ATOMIC_INIT(0);
+
+void claim_stats_task_enter(void) {
+    int i;
+
+    for (i = 0; i < CLAIM_MAX_TASKS; i++) {
+        if (claim_tasks[i].task == current) {
+            claim_tasks[i].depth++;
+            return;
+        }
+    }
+
+    for (i = 0; i < CLAIM_MAX_TASKS; i++) {
+        if (NULL == cmpxchg(&claim_tasks[i].task, NULL, current)) {
+            claim_tasks[i].depth = 1;
+            atomic_inc(&claim_tasks_active);
+            return;
+        }
+    }
+    /* Table full: the allocations of this task count as production allocations */
+}
+
+void claim_stats_task_exit(void) {
+    int i;
+
+    for (i = 0; i < CLAIM_MAX_TASKS; i++) {
+        if (claim_tasks[i].task == current) {
+            if (0 == --claim_tasks[i].depth) {
+                atomic_dec(&claim_tasks_active);
+                smp_wmb();
+                claim_tasks[i].task = NULL;
+            }
+            return;
+        }
+    }
+}
+
+int claim_stats_in_claimer(struct task_struct* task) {
+    int i;
+
+    if (!atomic_read(&claim_tasks_active))
+        return 0;
+
+    for (i = 0; i < CLAIM_MAX_TASKS; i++) {
+        if (ACCESS_ONCE(claim_tasks[i].task) == task)
+            return 1;
+    }
+    return 0;
+}
+
+static struct dentry* lock_stats_file;
+static struct dentry* claim_benchmark_file;
+static struct dentry* claim_costs_file;
+
+void claim_stats_record(struct claim_histogram* histogram, u64 duration_ns) {
+    int bucket = fls64(duration_ns);
+
+    if (bucket >= CLAIM_STATS_BUCKETS)
+        bucket = CLAIM_STATS_BUCKETS - 1;
+
+    atomic_long_inc(&histogram->buckets[bucket]);
+    atomic_long_inc(&histogram->count);
+    atomic64_add(duration_ns, &histogram->total_ns);
+
+    if (duration_ns > histogram->max_ns)
+        histogram->max_ns = duration_ns;
+}
+
+void claim_stats_reset_histogram(struct claim_histogram* histogram) {
+    int i;
+
+    for (i = 0; i < CLAIM_STATS_BUCKETS; i++)
+        atomic_long_set(&histogram->buckets[i], 0);
+
+    atomic_long_set(&histogram->count, 0);
+    atomic64_set(&histogram->total_ns, 0);
+    histogram->max_ns = 0;
+}
+
+static void claim_stats_reset(void) {
+    int section;
+
+    for (section = 0; section < CLAIM_NUM_SECTIONS; section++)
+        claim_stats_reset_histogram(&claim_histograms[section]);
+}
+
+/*
+ * Print one histogram. Empty buckets are skipped.
+ */
+void claim_stats_show_histogram(struct seq_file* m, struct claim_histogram* histogram) {
+    long count = atomic_long_read(&histogram->count);
+    u64 total_ns = atomic64_read(&histogram->total_ns);
+    int i;
+
+    seq_printf(m, "%s: count %ld, total %llu ns, avg %llu ns, max %lu ns\n", histogram->name,
+            count, total_ns, count ? div64_u64(total_ns, count) : 0, histogram->max_ns);
+
+    for (i = 0; i < CLAIM_STATS_BUCKETS; i++) {
+        long n = atomic_long_read(&histogram->buckets[i]);
+
+        if (!n)
+            continue;
+
+        if (i == CLAIM_STATS_BUCKETS - 1)
+            seq_printf(m, "\t>= %12llu ns: %ld\n", 1ULL << (i - 1), n);
+        else
+            seq_printf(m, "\t< %13llu ns: %ld\n", 1ULL << i, n);
+    }
+}
+
+static int lock_stats_show(struct seq_file* m, void* v) {
+    int section;
+
+    for (section = 0; section < CLAIM_NUM_SECTIONS; section++)
+        claim_stats_show_histogram(m, &claim_histograms[section]);
+
+    return 0;
+}
+
+static int lock_stats_open(struct inode* inode, struct file* file) {
+    return single_open(file, lock_stats_show, NULL);
+}
+
+static ssize_t lock_stats_write(struct file* file, const char __user* buf, size_t count, loff_t* ppos) {
+    claim_stats_reset();
+    return count;
+}
+
+static const struct file_operations lock_stats_fops = {
+    .owner = THIS_MODULE,
+    .open = lock_stats_open,
+    .read = seq_read,
+    .write = lock_stats_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+static int claim_costs_show(struct seq_file* m, void* v) {
+    struct claim_cost* cost;
+
+    seq_printf(m, "%-20s %12s %12s %14s %16s\n", "claimer", "attempts", "claimed", "ns/attempt", "ns/claimed frame");
+
+    for (cost = claim_costs; cost->name; cost++) {
+        long attempts = atomic_long_read(&cost->attempts);
+        long claimed = atomic_long_read(&cost->claimed);
+        u64 total_ns = atomic64_read(&cost->total_ns);
+
+        seq_printf(m, "%-20s %12ld %12ld %14llu ", cost->name, attempts, claimed, attempts ? div64_u64(total_ns, attempts) : 0);
+        if (claimed)
+            seq_printf(m, "%16llu\n", div64_u64(total_ns, claimed));
+        else
+            seq_printf(m, "%16s\n", "-");
+    }
+    return 0;
+}
+
+static int claim_costs_open(struct inode* inode, struct file* file) {
+    return single_open(file, claim_costs_show, NULL);
+}
+
+static ssize_t claim_costs_write(struct file* file, const char __user* buf, size_t count, loff_t* ppos) {
+    struct claim_cost* cost;
+
+    for (cost = claim_costs; cost->name; cost++) {
+        atomic_long_set(&cost->attempts, 0);
+        atomic_long_set(&cost->claimed, 0);
+        atomic64_set(&cost->total_ns, 0);
+    }
+    return count;
+}
+
+static const struct file_operations claim_costs_fops = {
+    .owner = THIS_MODULE,
+    .open = claim_costs_open,
+    .read = seq_read,
+    .write = claim_costs_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+/* The benchmark reschedules at least every CLAIM_BENCHMARK_RESCHED_PFNS pfns, claimed or not */
+#define CLAIM_BENCHMARK_RESCHED_PFNS 1024
+
+/*
+ * Where the next synthetic claim loop starts. Each run continues where the
+ * last one stopped, so that repeated runs cover all zones.
+ */
+static unsigned long claim_benchmark_next_pfn;
+
+/*
+ * Claim and immediately release up to num_claims free buddy pages, using
+ * the same code path as a 'Request pages' IOCTL.
+ *
+ * Returns the number of claimed pages.
+ */
+static unsigned long claim_benchmark(unsigned long num_claims, unsigned long* num_attempts) {
+    unsigned long claimed = 0;
+    unsigned long pfn = claim_benchmark_next_pfn;
+    unsigned long max_pfn = 0;
+    struct zone* zone;
+
+    for_each_populated_zone(zone) {
+        unsigned long zone_end_pfn = zone->zone_start_pfn + zone->spanned_pages;
+
+        if (zone_end_pfn > max_pfn)
+            max_pfn = zone_end_pfn;
+    }
+
+    *num_attempts = 0;
+
+    while (claimed < num_claims && pfn < max_pfn) {
+        struct page* requested_page;
+        struct page* allocated_page;
+        unsigned long actual_source = 0;
+        unsigned int failure_reason = CLAIM_FAILURE_NONE;
+
+        if (!pfn_valid(pfn))
+            goto next;
+
+        requested_page = pfn_to_page(pfn);
+
+        /* Only try pages that look like free buddy heads; this is racy but cheap */
+        if (!PageBuddy(requested_page))
+            goto next;
+
+        (*num_attempts)++;
+        allocated_page = requested_page;
+
+        if (CLAIMED_SUCCESSFULLY == try_claim_free_buddy_page(requested_page, SOURCE_FREE_BUDDY_PAGE, &allocated_page, &actual_source, &failure_reason)) {
+            __free_pages(allocated_page, 0);
+            claimed++;
+        }
+
+        cond_resched();
+next:
+        pfn++;
+        if (0 == pfn % CLAIM_BENCHMARK_RESCHED_PFNS)
+            cond_resched();
+    }
+
+    claim_benchmark_next_pfn = (pfn < max_pfn) ? pfn : 0;
+    return claimed;
+}
+
+static ssize_t claim_benchmark_write(struct file* file, const char __user* buf, size_t count, loff_t* ppos) {
+    char kbuf[32];
+    unsigned long num_claims, num_attempts, claimed;
+    u64 start_ns, duration_ns;
+
+    if (count >= sizeof (kbuf))
+        return -EINVAL;
+
+    if (copy_from_user(kbuf, buf, count))
+        return -EFAULT;
+    kbuf[count] = '\0';
+
+    num_claims = simple_strtoul(kbuf, NULL, 0);
+    if (!num_claims)
+        return -EINVAL;
+
+    claim_stats_reset();
+
+    start_ns = claim_stats_start();
+    claimed = claim_benchmark(num_claims, &num_attempts);
+    duration_ns = claim_stats_start() - start_ns;
+
+    printk(KERN_NOTICE "claim_benchmark: claimed %lu of %lu requested pages in %lu attempts, %llu ns. See lock_stats for the histograms.\n",
+            claimed, num_claims, num_attempts, duration_ns);
+
+    return count;
+}
+
+static const struct file_operations claim_benchmark_fops = {
+    .owner = THIS_MODULE,
+    .write = claim_benchmark_write,
+};
+
+int claim_stats_init(void) {
+    if (!phys_mem_debugfs_dir)
+        return -ENODEV;
+
+    lock_stats_file = debugfs_create_file("lock_stats", S_IRUSR | S_IWUSR, phys_mem_debugfs_dir, NULL, &lock_stats_fops);
+    claim_benchmark_file = debugfs_create_file("claim_benchmark", S_IWUSR, phys_mem_debugfs_dir, NULL, &claim_benchmark_fops);
+    claim_costs_file = debugfs_create_file("claim_costs", S_IRUSR | S_IWUSR, phys_mem_debugfs_dir, NULL, &claim_costs_fops);
+
+    if (!lock_stats_file || !claim_benchmark_file || !claim_costs_file) {
+        claim_stats_exit();
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+void claim_stats_exit(void) {
+    debugfs_remove(claim_costs_file);
+    debugfs_remove(claim_benchmark_file);
+    debugfs_remove(lock_stats_file);
+    claim_costs_file = NULL;
+    claim_benchmark_file = NULL;
+    lock_stats_file = NULL;
+}
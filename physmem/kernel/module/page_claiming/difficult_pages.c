@@ -48,7 +48,7 @@
  * undesirable effects. This implementation ABORTs the freeing process for these pages.
  *
  */
-int ignore_difficult_pages(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source) {
+int ignore_difficult_pages(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason) {
   int ret = CLAIMED_TRY_NEXT;
 
    unsigned long requested_pfn = page_to_pfn(requested_page);
@@ -58,8 +58,10 @@ int ignore_difficult_pages(struct page* requested_page, unsigned int allowed_sou
 //   unsigned int is_kernel_code = (requested_pfn <= pfn(_end));
    unsigned int is_kernel_code =  (page_to_phys(requested_page) <= 0x800 ) && !is_first_mb;
 
-   if (is_first_mb || is_kernel_code)
+   if (is_first_mb || is_kernel_code) {
+     *failure_reason = CLAIM_FAILURE_PROTECTED;
      ret = CLAIMED_ABORT;
+   }
 
    return ret;
 }
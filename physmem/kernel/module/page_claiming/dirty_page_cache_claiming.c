@@ -0,0 +1,451 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Claiming dirty page-cache pages after a targeted writeback.
+ *
+ * See dirty_writeback.h for a complete documentation!
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel.h>       /* printk() */
+#include <linux/errno.h>        /* error codes */
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/radix-tree.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include "phys_mem.h"           /* local definitions */
+#include "phys_mem_int.h"           /* local definitions */
+#include "page_claiming.h"           /* local definitions */
+#include "claim_stats.h"           /* local definitions */
+#include "dirty_writeback.h"           /* local definitions */
+
+static unsigned long dirty_writeback_max_inflight = 4096;
+module_param(dirty_writeback_max_inflight, ulong, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dirty_writeback_max_inflight, "Maximum number of dirty pages queued or under writeback for the claimer (0: no writeback)");
+
+/* A page queued for writeback. The inode is pinned (igrab) */
+struct dirty_page {
+    struct inode* inode;
+    pgoff_t index;
+};
+
+struct writeback_batch {
+    struct work_struct work;
+    u64 queued_ns;
+    unsigned long num_pages;
+    struct dirty_page pages[0];
+};
+
+/* The pages queued by the running Request-Pages commands */
+static struct dirty_page pending[DIRTY_WRITEBACK_MAX_BATCH];
+static unsigned long num_pending;
+static DEFINE_SPINLOCK(pending_lock);
+
+/* Pages queued or under writeback */
+static atomic_long_t inflight = ATOMIC_LONG_INIT(0);
+
+/*
+ * The pages queued by this claimer, by pfn. Only these pages are claimed
+ * once they are clean; all other clean page-cache pages are left to the
+ * hwpoison claimer. The mapping is compared, never dereferenced.
+ */
+struct queued_page {
+    unsigned long pfn;
+    struct address_space* mapping;
+    pgoff_t index;
+};
+
+static RADIX_TREE(queued_pages, GFP_ATOMIC);
+static unsigned long num_queued_pages;
+static DEFINE_SPINLOCK(queued_pages_lock);
+
+/* The writeback runs here and not on keventd: it waits for the I/O */
+static struct workqueue_struct* dirty_writeback_wq;
+
+static atomic_long_t batches_written = ATOMIC_LONG_INIT(0);
+static atomic_long_t pages_queued = ATOMIC_LONG_INIT(0);
+static atomic_long_t pages_refused = ATOMIC_LONG_INIT(0);
+static atomic_long_t ranges_written = ATOMIC_LONG_INIT(0);
+static atomic_long_t bytes_written = ATOMIC_LONG_INIT(0);
+static atomic_long_t write_errors = ATOMIC_LONG_INIT(0);
+static atomic_long_t pages_claimed = ATOMIC_LONG_INIT(0);
+static atomic64_t total_latency_ns = ATOMIC64_INIT(0);
+static u64 max_latency_ns;                 /* updated racy, good enough for a statistic */
+
+static struct dentry* dirty_writeback_file;
+
+/*
+ * A page-cache page? Pages of the swap cache have a mapping as well, but
+ * are anonymous.
+ */
+static inline int is_page_cache(struct page* page) {
+    return page->mapping && !PageAnon(page) && !PageSwapCache(page) && !PageSlab(page) && !PageCompound(page);
+}
+
+/*
+ * Queue the locked page for writeback. Returns 0 if the page is queued.
+ */
+static int queue_dirty_page(struct page* page) {
+    struct inode* inode;
+    int ret = -EBUSY;
+
+    if (!dirty_writeback_wq)
+        goto out_refused_now;
+
+    if (atomic_long_inc_return(&inflight) > dirty_writeback_max_inflight)
+        goto out_refused;
+
+    inode = igrab(page->mapping->host);
+    if (!inode)
+        goto out_refused;
+
+    spin_lock(&pending_lock);
+    if (num_pending < DIRTY_WRITEBACK_MAX_BATCH) {
+        pending[num_pending].inode = inode;
+        pending[num_pending].index = page->index;
+        num_pending++;
+        ret = 0;
+    }
+    spin_unlock(&pending_lock);
+
+    if (!ret) {
+        atomic_long_inc(&pages_queued);
+        return 0;
+    }
+
+    iput(inode);
+out_refused:
+    atomic_long_dec(&inflight);
+out_refused_now:
+    atomic_long_inc(&pages_refused);
+    return ret;
+}
+
+/*
+ * Remember a page queued for writeback. A page queued again replaces the
+ * old entry. With DIRTY_WRITEBACK_MAX_TRACKED pages remembered further
+ * pages are written back, but not claimed by this claimer.
+ */
+static void remember_queued_page(unsigned long pfn, struct address_space* mapping, pgoff_t index) {
+    struct queued_page* q;
+    struct queued_page* old;
+
+    q = kmalloc(sizeof (struct queued_page), GFP_KERNEL);
+    if (!q)
+        return;
+    q->pfn = pfn;
+    q->mapping = mapping;
+    q->index = index;
+
+    if (radix_tree_preload(GFP_KERNEL)) {
+        kfree(q);
+        return;
+    }
+
+    spin_lock(&queued_pages_lock);
+    old = radix_tree_delete(&queued_pages, pfn);
+    if (old)
+        num_queued_pages--;
+    if (num_queued_pages < DIRTY_WRITEBACK_MAX_TRACKED && !radix_tree_insert(&queued_pages, pfn, q)) {
+        num_queued_pages++;
+        q = NULL;
+    }
+    spin_unlock(&queued_pages_lock);
+    radix_tree_preload_end();
+
+    kfree(old);
+    kfree(q);
+}
+
+/*
+ * Was the page queued by this claimer? An entry for another page at the
+ * same pfn (the queued page has been freed and reused) is dropped.
+ */
+static int was_queued(struct page* page) {
+    unsigned long pfn = page_to_pfn(page);
+    struct queued_page* q;
+    struct queued_page* stale = NULL;
+    int ret = 0;
+
+    spin_lock(&queued_pages_lock);
+    q = radix_tree_lookup(&queued_pages, pfn);
+    if (q) {
+        if (q->mapping == page->mapping && q->index == page->index) {
+            ret = 1;
+        } else {
+            stale = radix_tree_delete(&queued_pages, pfn);
+            num_queued_pages--;
+        }
+    }
+    spin_unlock(&queued_pages_lock);
+
+    kfree(stale);
+    return ret;
+}
+
+static void forget_queued_page(unsigned long pfn) {
+    struct queued_page* q;
+
+    spin_lock(&queued_pages_lock);
+    q = radix_tree_delete(&queued_pages, pfn);
+    if (q)
+        num_queued_pages--;
+    spin_unlock(&queued_pages_lock);
+
+    kfree(q);
+}
+
+int try_claim_dirty_page_cache(struct page* requested_page, unsigned int allowed_sources, struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason) {
+    struct address_space* mapping = NULL;
+    pgoff_t index = 0;
+    int ret;
+
+    if (!(allowed_sources & SOURCE_DIRTY_PAGE_CACHE) || !is_page_cache(requested_page))
+        return CLAIMED_TRY_NEXT;
+
+    if (!PageDirty(requested_page) && !PageWriteback(requested_page)) {
+        /* Clean pages this claimer did not write back are not ours */
+        if (!was_queued(requested_page))
+            return CLAIMED_TRY_NEXT;
+
+        /* Clean again: the clean page-cache path */
+        ret = try_claim_page_via_hwpoison(requested_page, SOURCE_HW_POISON_PAGE_CACHE, allocated_page, actual_source, failure_reason);
+        if (CLAIMED_SUCCESSFULLY == ret) {
+            forget_queued_page(page_to_pfn(requested_page));
+            *actual_source = SOURCE_DIRTY_PAGE_CACHE;
+            atomic_long_inc(&pages_claimed);
+        }
+        return ret;
+    }
+
+    *failure_reason = CLAIM_FAILURE_BUSY;
+
+    if (PageWriteback(requested_page) || !trylock_page(requested_page))
+        return CLAIMED_TRY_NEXT;
+
+    /* page->mapping is stable while the page is locked */
+    if (is_page_cache(requested_page) && PageDirty(requested_page) && dirty_writeback_max_inflight &&
+            !queue_dirty_page(requested_page)) {
+        mapping = requested_page->mapping;
+        index = requested_page->index;
+    }
+
+    unlock_page(requested_page);
+
+    if (mapping)
+        remember_queued_page(page_to_pfn(requested_page), mapping, index);
+    return CLAIMED_TRY_NEXT;
+}
+
+static int compare_dirty_pages(const void* a, const void* b) {
+    const struct dirty_page* x = a;
+    const struct dirty_page* y = b;
+
+    if (x->inode != y->inode)
+        return x->inode < y->inode ? -1 : 1;
+    if (x->index != y->index)
+        return x->index < y->index ? -1 : 1;
+    return 0;
+}
+
+/*
+ * Call `fn` for each range of consecutive pages of the same file in the
+ * (sorted) batch. Returns the number of ranges, *num_pages is the number of
+ * distinct pages.
+ */
+static unsigned long for_each_range(struct writeback_batch* batch, int (*fn)(struct address_space*, loff_t, loff_t), unsigned long* num_pages) {
+    unsigned long num_ranges = 0;
+    unsigned long first, last;
+
+    *num_pages = 0;
+    for (first = 0; first < batch->num_pages; first = last + 1) {
+        struct dirty_page* start = &batch->pages[first];
+
+        /* Pages requested twice are queued twice */
+        last = first;
+        while (last + 1 < batch->num_pages && batch->pages[last + 1].inode == start->inode &&
+                batch->pages[last + 1].index <= batch->pages[last].index + 1)
+            last++;
+
+        if (fn(start->inode->i_mapping, (loff_t) start->index << PAGE_CACHE_SHIFT,
+                ((loff_t) (batch->pages[last].index + 1) << PAGE_CACHE_SHIFT) - 1))
+            atomic_long_inc(&write_errors);
+
+        *num_pages += batch->pages[last].index - start->index + 1;
+        num_ranges++;
+    }
+    return num_ranges;
+}
+
+static int write_range(struct address_space* mapping, loff_t start, loff_t end) {
+    return filemap_fdatawrite_range(mapping, start, end);
+}
+
+static int wait_range(struct address_space* mapping, loff_t start, loff_t end) {
+    return filemap_fdatawait_range(mapping, start, end);
+}
+
+/*
+ * Write back a batch: start the I/O of all ranges, then wait for it.
+ */
+static void writeback_batch_work(struct work_struct* work) {
+    struct writeback_batch* batch = container_of(work, struct writeback_batch, work);
+    unsigned long num_pages;
+    unsigned long i;
+    u64 latency_ns;
+
+    sort(batch->pages, batch->num_pages, sizeof (struct dirty_page), compare_dirty_pages, NULL);
+
+    atomic_long_add(for_each_range(batch, write_range, &num_pages), &ranges_written);
+    atomic_long_add(num_pages << PAGE_CACHE_SHIFT, &bytes_written);
+
+    for_each_range(batch, wait_range, &num_pages);
+
+    latency_ns = claim_stats_start() - batch->queued_ns;
+    atomic64_add(latency_ns, &total_latency_ns);
+    if (latency_ns > max_latency_ns)
+        max_latency_ns = latency_ns;
+    atomic_long_inc(&batches_written);
+
+    for (i = 0; i < batch->num_pages; i++)
+        iput(batch->pages[i].inode);
+
+    atomic_long_sub(batch->num_pages, &inflight);
+    kfree(batch);
+}
+
+void dirty_writeback_submit(void) {
+    struct writeback_batch* batch;
+
+    if (!num_pending)
+        return;
+
+    /* Without a batch the pages stay queued until the next command */
+    batch = kmalloc(sizeof (struct writeback_batch) + DIRTY_WRITEBACK_MAX_BATCH * sizeof (struct dirty_page), GFP_KERNEL);
+    if (!batch)
+        return;
+
+    spin_lock(&pending_lock);
+    memcpy(batch->pages, pending, num_pending * sizeof (struct dirty_page));
+    batch->num_pages = num_pending;
+    num_pending = 0;
+    spin_unlock(&pending_lock);
+
+    if (!batch->num_pages) {
+        kfree(batch);
+        return;
+    }
+
+    INIT_WORK(&batch->work, writeback_batch_work);
+    batch->queued_ns = claim_stats_start();
+    queue_work(dirty_writeback_wq, &batch->work);
+}
+
+static int dirty_writeback_show(struct seq_file* m, void* v) {
+    long batches = atomic_long_read(&batches_written);
+
+    seq_printf(m, "max inflight: %lu\n", dirty_writeback_max_inflight);
+    seq_printf(m, "inflight: %ld\n", atomic_long_read(&inflight));
+    seq_printf(m, "pages remembered: %lu\n", num_queued_pages);
+    seq_printf(m, "pages queued: %ld\n", atomic_long_read(&pages_queued));
+    seq_printf(m, "pages refused: %ld\n", atomic_long_read(&pages_refused));
+    seq_printf(m, "batches written: %ld\n", batches);
+    seq_printf(m, "ranges written: %ld\n", atomic_long_read(&ranges_written));
+    seq_printf(m, "bytes written: %ld\n", atomic_long_read(&bytes_written));
+    seq_printf(m, "write errors: %ld\n", atomic_long_read(&write_errors));
+    seq_printf(m, "batch latency avg: %llu us\n", batches ? div_u64(div_u64(atomic64_read(&total_latency_ns), batches), NSEC_PER_USEC) : 0ULL);
+    seq_printf(m, "batch latency max: %llu us\n", div_u64(max_latency_ns, NSEC_PER_USEC));
+    seq_printf(m, "pages claimed after writeback: %ld\n", atomic_long_read(&pages_claimed));
+    return 0;
+}
+
+static int dirty_writeback_open(struct inode* inode, struct file* file) {
+    return single_open(file, dirty_writeback_show, NULL);
+}
+
+static ssize_t dirty_writeback_write(struct file* file, const char __user* buf, size_t count, loff_t* ppos) {
+    atomic_long_set(&batches_written, 0);
+    atomic_long_set(&pages_queued, 0);
+    atomic_long_set(&pages_refused, 0);
+    atomic_long_set(&ranges_written, 0);
+    atomic_long_set(&bytes_written, 0);
+    atomic_long_set(&write_errors, 0);
+    atomic_long_set(&pages_claimed, 0);
+    atomic64_set(&total_latency_ns, 0);
+    max_latency_ns = 0;
+    return count;
+}
+
+static const struct file_operations dirty_writeback_fops = {
+    .owner = THIS_MODULE,
+    .open = dirty_writeback_open,
+    .read = seq_read,
+    .write = dirty_writeback_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+int dirty_writeback_init(void) {
+    dirty_writeback_wq = create_singlethread_workqueue("phys_mem_writeback");
+    if (!dirty_writeback_wq) {
+        printk(KERN_WARNING "phys_mem: cannot create the writeback workqueue, dirty pages are not written back\n");
+        return -ENOMEM;
+    }
+
+    if (phys_mem_debugfs_dir)
+        dirty_writeback_file = debugfs_create_file("dirty_writeback", S_IRUSR | S_IWUSR, phys_mem_debugfs_dir, NULL, &dirty_writeback_fops);
+
+    return 0;
+}
+
+void dirty_writeback_exit(void) {
+    struct queued_page* q[16];
+    unsigned int n;
+    unsigned long i;
+
+    /* The batches in flight hold inodes; destroying the queue flushes it */
+    if (dirty_writeback_wq) {
+        destroy_workqueue(dirty_writeback_wq);
+        dirty_writeback_wq = NULL;
+    }
+
+    for (i = 0; i < num_pending; i++)
+        iput(pending[i].inode);
+    num_pending = 0;
+
+    /* No claimer runs any more */
+    while ((n = radix_tree_gang_lookup(&queued_pages, (void**) q, 0, ARRAY_SIZE(q)))) {
+        for (i = 0; i < n; i++) {
+            radix_tree_delete(&queued_pages, q[i]->pfn);
+            kfree(q[i]);
+        }
+    }
+    num_queued_pages = 0;
+
+    debugfs_remove(dirty_writeback_file);
+    dirty_writeback_file = NULL;
+}
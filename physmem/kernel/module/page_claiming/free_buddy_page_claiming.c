@@ -42,6 +42,8 @@
 #include "phys_mem_int.h"           /* local definitions */
 #include "page_claiming.h"           /* local definitions */
 #include "page_alloc_clone.h"           /* local definitions */
+#include "claim_stats.h"           /* local definitions */
+#include "spare_pool.h"           /* local definitions */
 
 static struct page *
 claim_free_buddy_page(struct page * requested);
@@ -50,6 +52,20 @@ is_free_buddy_page(struct page *page);
 static int
 prep_new_page(struct page *page, int order);
 
+/*
+ * Why a page with a refcount cannot be claimed from the buddy system
+ */
+static unsigned int
+in_use_reason(struct page* page) {
+    struct page* head = compound_head(page);
+
+    if (PageSlab(head) || PageReserved(head))
+        return CLAIM_FAILURE_UNMOVABLE;
+    if (PageLocked(head) || PageWriteback(head))
+        return CLAIM_FAILURE_BUSY;
+    return CLAIM_FAILURE_IN_USE;
+}
+
 /**
  * Claim a given page from the buddy subsystem. This only works, if the page registered within the buddy system and marked as free
  *
@@ -57,7 +73,7 @@ prep_new_page(struct page *page, int order);
 int
 try_claim_free_buddy_page(struct page* requested_page,
         unsigned int allowed_sources, struct page** allocated_page,
-        unsigned long* actual_source) {
+        unsigned long* actual_source, unsigned int* failure_reason) {
     int ret = CLAIMED_TRY_NEXT;
 
     if (allowed_sources & SOURCE_FREE_BUDDY_PAGE) {
@@ -65,11 +81,13 @@ try_claim_free_buddy_page(struct page* requested_page,
         struct page * locked_page = NULL;
         unsigned long pfn = page_to_pfn(requested_page);
         unsigned int locked_page_count_after, locked_page_count_before;
+        u64 isolation_start;
 
         /*
          * Isolate the page, so that it doesn't get reallocated if it
          * was free.
          */
+        isolation_start = claim_stats_enter(CLAIM_SECTION_ISOLATION);
         set_migratetype_isolate(requested_page);
         locked_page_count_before = page_count(requested_page);
         if (0 == page_count(compound_head(requested_page))) {
@@ -77,7 +95,11 @@ try_claim_free_buddy_page(struct page* requested_page,
                 printk(KERN_DEBUG "try_claim_free_buddy_page: %#lx free buddy page\n", pfn);
                 /* get, while page is still isolated */
                 locked_page = claim_free_buddy_page(requested_page);
+                if (!locked_page)
+                    *failure_reason = CLAIM_FAILURE_RACE;
             } else {
+                /* On its way into or out of the buddy system */
+                *failure_reason = CLAIM_FAILURE_RACE;
                 printk(KERN_DEBUG
                         "try_claim_free_buddy_page: %#lx: unknown zero refcount page type %lx\n",
                         pfn, requested_page->flags);
@@ -86,12 +108,14 @@ try_claim_free_buddy_page(struct page* requested_page,
             long cppfn = page_to_pfn(compound_head(requested_page));
 
             /* Not a free page */
+            *failure_reason = in_use_reason(requested_page);
             printk(KERN_DEBUG
                     "try_claim_free_buddy_page: %#lx: %#lx refcount %i ,page type %lx\n",
                     pfn, cppfn, page_count(compound_head(requested_page)), requested_page->flags);
 
         }
         unset_migratetype_isolate(requested_page);
+        claim_stats_end(CLAIM_SECTION_ISOLATION, isolation_start);
 
         if (locked_page) {
             /*
@@ -118,6 +142,10 @@ try_claim_free_buddy_page(struct page* requested_page,
  *
  * Source:
  * This methods implementation has been inspired by  "__rmqueue_smallest"
+ *
+ * Free blocks of order >= whole_block_order are not split: the whole block is
+ * taken and all frames except the requested one are parked in the spare
+ * pool (see spare_pool.h).
  */
 static inline struct page *
 claim_free_buddy_page(struct page * requested) {
@@ -125,15 +153,20 @@ claim_free_buddy_page(struct page * requested) {
     struct page* ret = NULL;
 
     unsigned int order = 0;
+    unsigned int whole_block = 0;       /* > 0: the order of the block taken as a whole */
+    int block_order = ACCESS_ONCE(whole_block_order);
     struct zone *zone;
 
     int requested_page_count;
+    u64 lru_lock_start, zone_lock_start;
 
     zone = page_zone(requested);
     /* Protect the lru list */
+    lru_lock_start = claim_stats_enter(CLAIM_SECTION_LRU_LOCK);
     spin_lock(&zone->lru_lock);
 
     /* Protect the area */
+    zone_lock_start = claim_stats_enter(CLAIM_SECTION_ZONE_LOCK);
     spin_lock(&zone->lock);
 
     requested_page_count = page_count(requested);
@@ -152,7 +185,11 @@ claim_free_buddy_page(struct page * requested) {
         list_del(&requested->lru);
         rmv_page_order__clone(requested);
         area->nr_free--;
-        expand__clone(zone, requested, order, current_order, area, migratetype);
+
+        if (block_order > 0 && current_order >= block_order)
+            whole_block = current_order;
+        else
+            expand__clone(zone, requested, order, current_order, area, migratetype);
 
         ret = requested;
     } else {
@@ -160,11 +197,36 @@ claim_free_buddy_page(struct page * requested) {
     }
 
     spin_unlock(&zone->lock);
+    claim_stats_end(CLAIM_SECTION_ZONE_LOCK, zone_lock_start);
     spin_unlock(&zone->lru_lock);
+    claim_stats_end(CLAIM_SECTION_LRU_LOCK, lru_lock_start);
 
     if (ret) {
+        struct page* head = ret;
+
+        /*
+         * Frames in a bad state are leaked, like the page allocator does
+         * (bad_page()): they are neither handed out nor freed again.
+         */
         if (prep_new_page(ret, 0)) {
             printk(KERN_ALERT "Could not prep_new_page %p, %lu \n", ret, page_to_pfn(ret));
+            ret = NULL;
+        }
+
+        if (whole_block) {
+            DECLARE_BITMAP(bad, 1 << (MAX_ORDER - 1));
+            unsigned long i;
+
+            bitmap_zero(bad, 1UL << whole_block);
+
+            /* The block is ours: turn it into 2^whole_block refcounted frames */
+            for (i = 1; i < (1UL << whole_block); i++) {
+                if (prep_new_page(head + i, 0)) {
+                    printk(KERN_ALERT "Could not prep_new_page %p, %lu \n", head + i, page_to_pfn(head + i));
+                    set_bit(i, bad);
+                }
+            }
+            spare_pool_add_block(head, whole_block, head, bad);
         }
     }
     return ret;
@@ -285,7 +347,9 @@ is_free_buddy_page(struct page *page) {
     unsigned long pfn = page_to_pfn(page);
     unsigned long flags;
     int order;
+    u64 zone_lock_start;
 
+    zone_lock_start = claim_stats_enter(CLAIM_SECTION_ZONE_LOCK);
     spin_lock_irqsave(&zone->lock, flags);
     for (order = 0; order < MAX_ORDER; order++) {
         struct page *page_head = page - (pfn & ((1 << order) - 1));
@@ -294,6 +358,7 @@ is_free_buddy_page(struct page *page) {
             break;
     }
     spin_unlock_irqrestore(&zone->lock, flags);
+    claim_stats_end(CLAIM_SECTION_ZONE_LOCK, zone_lock_start);
 
     return order < MAX_ORDER;
 }
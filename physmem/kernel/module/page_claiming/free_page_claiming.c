@@ -78,7 +78,7 @@ static inline int free_pages_check__just_test(struct page *page)
          * that may make page_freeze_refs()/page_unfreeze_refs() mismatch.
  *
  */
-inline int try_claim_free_page(struct page* requested_page, unsigned int allowed_sources, struct page** allocated_page, unsigned long* actual_source) {
+inline int try_claim_free_page(struct page* requested_page, unsigned int allowed_sources, struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason) {
   int ret = CLAIMED_TRY_NEXT;
 
   int enabled = 0;
@@ -0,0 +1,306 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Verify free buddy pages against the free page poison pattern.
+ *
+ * See free_scan.h for a complete documentation!
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel.h>       /* printk() */
+#include <linux/errno.h>        /* error codes */
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/poison.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>        /* cond_resched() */
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <asm/uaccess.h>
+
+#include "phys_mem.h"           /* local definitions */
+#include "phys_mem_int.h"           /* local definitions */
+#include "page_alloc_clone.h"           /* local definitions */
+#include "free_scan.h"           /* local definitions */
+
+static int free_scan_pattern = -1;
+module_param(free_scan_pattern, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(free_scan_pattern, "Byte free pages are filled with (-1: PAGE_POISON of CONFIG_PAGE_POISONING)");
+
+/* Serialises the scans and protects everything below */
+static DEFINE_MUTEX(free_scan_mutex);
+
+static unsigned long free_scan_cursor;
+static unsigned long pages_verified;
+static unsigned long pages_raced;
+static unsigned long num_suspects;
+static unsigned long suspects[FREE_SCAN_MAX_SUSPECTS];
+
+static struct dentry* free_scan_file;
+
+/*
+ * The pfn after the highest pfn of all zones
+ */
+static unsigned long free_scan_end_pfn(void) {
+    unsigned long end_pfn = 0;
+    struct zone* zone;
+
+    for_each_populated_zone(zone) {
+        unsigned long zone_end_pfn = zone->zone_start_pfn + zone->spanned_pages;
+
+        if (zone_end_pfn > end_pfn)
+            end_pfn = zone_end_pfn;
+    }
+    return end_pfn;
+}
+
+/*
+ * Is the page expected to hold the pattern? Called for pages of a free block.
+ */
+static inline int is_verifiable(struct page* page) {
+    if (PageHighMem(page))
+        return 0;
+
+    if (free_scan_pattern >= 0)
+        return 1;
+
+#ifdef CONFIG_PAGE_POISONING
+    return test_bit(PAGE_DEBUG_FLAG_POISON, &page->debug_flags);
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Returns true if every byte of the (lowmem) page equals the pattern
+ */
+static int holds_pattern(struct page* page, unsigned long pattern) {
+    unsigned long* word = page_address(page);
+    unsigned long* end = word + PAGE_SIZE / sizeof (unsigned long);
+
+    for (; word < end; word++)
+        if (unlikely(*word != pattern))
+            return 0;
+
+    return 1;
+}
+
+/*
+ * The order of the free block at `head`, -1 if `head` is no free block head
+ */
+static int free_block_order(struct page* head) {
+    struct zone* zone = page_zone(head);
+    unsigned long flags;
+    int order = -1;
+
+    spin_lock_irqsave(&zone->lock, flags);
+    if (PageBuddy(head))
+        order = page_order__clone(head);
+    spin_unlock_irqrestore(&zone->lock, flags);
+
+    return order;
+}
+
+/*
+ * Verify the free block head..head + 2^order - 1 without claiming it. The
+ * pages are read without zone->lock; a mismatch only counts if the block is
+ * still the same free block afterwards.
+ */
+static void verify_free_block(struct page* head, int order, unsigned long pattern) {
+    unsigned long head_pfn = page_to_pfn(head);
+    unsigned long nr_pages = 1UL << order;
+    unsigned long first_bad = nr_pages;
+    unsigned long bad[8];
+    unsigned long num_bad = 0;
+    unsigned long i;
+
+    for (i = 0; i < nr_pages; i++) {
+        if (!is_verifiable(head + i))
+            continue;
+
+        pages_verified++;
+        if (likely(holds_pattern(head + i, pattern)))
+            continue;
+
+        if (first_bad == nr_pages)
+            first_bad = i;
+        if (num_bad < ARRAY_SIZE(bad))
+            bad[num_bad] = head_pfn + i;
+        num_bad++;
+    }
+
+    if (likely(!num_bad))
+        return;
+
+    if (free_block_order(head) != order) {
+        /* Allocated while being read: the content is legitimately not the pattern */
+        pages_raced += num_bad;
+        return;
+    }
+
+    printk(KERN_WARNING "free_scan: %lu free pages of the order %d block at pfn %#lx do not hold the pattern %#02lx, first at pfn %#lx\n",
+            num_bad, order, head_pfn, pattern & 0xff, head_pfn + first_bad);
+
+    for (i = 0; i < min(num_bad, (unsigned long) ARRAY_SIZE(bad)); i++) {
+        if (num_suspects < FREE_SCAN_MAX_SUSPECTS)
+            suspects[num_suspects] = bad[i];
+        num_suspects++;
+    }
+}
+
+/*
+ * Verify the free blocks among the next nr_pfns pfns from the cursor.
+ * free_scan_mutex must be held.
+ */
+static void free_scan_step(unsigned long nr_pfns) {
+    unsigned long end_pfn = free_scan_end_pfn();
+    unsigned long pattern;
+    unsigned long pfn = free_scan_cursor;
+    unsigned long since_resched = 0;
+
+    if (free_scan_pattern >= 0)
+        pattern = (~0UL / 0xff) * (free_scan_pattern & 0xff);
+    else
+        pattern = (~0UL / 0xff) * PAGE_POISON;
+
+    while (nr_pfns) {
+        struct page* page;
+        unsigned long step = 1;
+        int order;
+
+        if (pfn >= end_pfn)
+            pfn = 0;
+
+        if (!pfn_valid(pfn))
+            goto next;
+
+        page = pfn_to_page(pfn);
+
+        /* Racy but cheap, free_block_order() checks again */
+        if (!PageBuddy(page))
+            goto next;
+
+        order = free_block_order(page);
+        if (order < 0)
+            goto next;
+
+        verify_free_block(page, order, pattern);
+        step = 1UL << order;
+next:
+        step = min(step, nr_pfns);
+        pfn += step;
+        nr_pfns -= step;
+
+        /* Skipped (used) pfns are cheap, but a scan over all of them is not */
+        since_resched += step;
+        if (since_resched >= FREE_SCAN_RESCHED_PFNS) {
+            since_resched = 0;
+            cond_resched();
+            if (fatal_signal_pending(current))
+                break;
+        }
+    }
+
+    free_scan_cursor = pfn;
+}
+
+static int free_scan_show(struct seq_file* m, void* v) {
+    unsigned long i;
+
+    mutex_lock(&free_scan_mutex);
+
+    if (free_scan_pattern >= 0)
+        seq_printf(m, "pattern: %#x\n", free_scan_pattern & 0xff);
+    else
+        seq_printf(m, "pattern: %#x (page poisoning)\n", PAGE_POISON);
+    seq_printf(m, "cursor: %#lx\n", free_scan_cursor);
+    seq_printf(m, "pages verified: %lu\n", pages_verified);
+    seq_printf(m, "pages allocated while read: %lu\n", pages_raced);
+    seq_printf(m, "suspects: %lu\n", num_suspects);
+
+    for (i = 0; i < min(num_suspects, (unsigned long) FREE_SCAN_MAX_SUSPECTS); i++)
+        seq_printf(m, "suspect %#lx\n", suspects[i]);
+
+    mutex_unlock(&free_scan_mutex);
+    return 0;
+}
+
+static int free_scan_open(struct inode* inode, struct file* file) {
+    return single_open(file, free_scan_show, NULL);
+}
+
+static ssize_t free_scan_write(struct file* file, const char __user* buf, size_t count, loff_t* ppos) {
+    char kbuf[32];
+    unsigned long nr_pfns;
+
+    if (count >= sizeof (kbuf))
+        return -EINVAL;
+
+    if (copy_from_user(kbuf, buf, count))
+        return -EFAULT;
+    kbuf[count] = '\0';
+
+    /* More than one pass over all pfns verifies nothing new */
+    nr_pfns = min(simple_strtoul(kbuf, NULL, 0), free_scan_end_pfn());
+
+#ifndef CONFIG_PAGE_POISONING
+    if (free_scan_pattern < 0)
+        return -EOPNOTSUPP;
+#endif
+
+    if (mutex_lock_interruptible(&free_scan_mutex))
+        return -ERESTARTSYS;
+
+    if (nr_pfns) {
+        free_scan_step(nr_pfns);
+    } else {
+        free_scan_cursor = 0;
+        pages_verified = 0;
+        pages_raced = 0;
+        num_suspects = 0;
+    }
+
+    mutex_unlock(&free_scan_mutex);
+    return count;
+}
+
+static const struct file_operations free_scan_fops = {
+    .owner = THIS_MODULE,
+    .open = free_scan_open,
+    .read = seq_read,
+    .write = free_scan_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+int free_scan_init(void) {
+    if (!phys_mem_debugfs_dir)
+        return -ENODEV;
+
+    free_scan_file = debugfs_create_file("free_scan", S_IRUSR | S_IWUSR, phys_mem_debugfs_dir, NULL, &free_scan_fops);
+    if (!free_scan_file)
+        return -ENOMEM;
+
+    return 0;
+}
+
+void free_scan_exit(void) {
+    debugfs_remove(free_scan_file);
+    free_scan_file = NULL;
+}
@@ -0,0 +1,380 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Test memory blocks before they are onlined.
+ *
+ * See hotplug_test.h for a complete documentation!
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel.h>       /* printk() */
+#include <linux/errno.h>        /* error codes */
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+#include <linux/memory.h>
+#include <linux/notifier.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>        /* cond_resched() */
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#ifdef CONFIG_X86
+#include <asm/system.h>         /* clflush() */
+#include <asm/cpufeature.h>
+#include <asm/processor.h>
+#endif
+
+#include "phys_mem.h"           /* local definitions */
+#include "phys_mem_int.h"           /* local definitions */
+#include "claim_stats.h"           /* local definitions */
+#include "hotplug_test.h"           /* local definitions */
+
+static int hotplug_test = 1;
+module_param(hotplug_test, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(hotplug_test, "Test memory blocks when they are onlined, before the allocator uses them");
+
+static unsigned long hotplug_test_fail_pfn;
+module_param(hotplug_test_fail_pfn, ulong, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(hotplug_test_fail_pfn, "Fault injection: treat this pfn as bad when its block is tested (0: none)");
+
+#ifdef CONFIG_MEMORY_HOTPLUG
+
+struct tested_block {
+    unsigned long start_pfn;
+    unsigned long nr_pages;
+    unsigned long pages_tested;
+    unsigned long pages_bad;
+    u64 duration_ns;
+    int vetoed;                         /* not onlined because of bad frames */
+};
+
+/* Serialises the tests and protects everything below */
+static DEFINE_MUTEX(hotplug_test_mutex);
+
+static unsigned long blocks_tested;
+static unsigned long pages_tested;
+static unsigned long pages_skipped;
+static u64 total_duration_ns;
+
+static struct tested_block tested_blocks[HOTPLUG_TEST_MAX_BLOCKS];
+static unsigned long num_tested_blocks;          /* the last HOTPLUG_TEST_MAX_BLOCKS are kept */
+
+static unsigned long bad_pfns[HOTPLUG_TEST_MAX_BAD];
+static unsigned long num_bad;
+
+static struct dentry* hotplug_test_file;
+
+/*
+ * The value of the pattern for the word at `word`
+ */
+static inline unsigned long pattern_value(int pattern, unsigned long* word) {
+    switch (pattern) {
+        case 0: return 0UL;
+        case 1: return ~0UL;
+        case 2: return (unsigned long) word;
+        default: return ~(unsigned long) word;
+    }
+}
+
+#define NUM_PATTERNS    4
+
+/*
+ * Can the frame be tested? It must be mapped, and must not be known bad.
+ */
+static inline int is_testable(unsigned long pfn) {
+    struct page* page;
+
+    if (!pfn_valid(pfn))
+        return 0;
+
+    page = pfn_to_page(pfn);
+    return !PageHighMem(page) && !PageHWPoison(page);
+}
+
+/*
+ * Write back and evict the testable frames of the chunk from all cache
+ * levels, so that the verification reads the DRAM.
+ */
+static void flush_chunk(unsigned long start_pfn, unsigned long nr_pages) {
+#ifdef CONFIG_X86
+    unsigned int line = boot_cpu_data.x86_clflush_size;
+    unsigned long i;
+
+    if (!cpu_has_clflush || !line)
+        return;
+
+    mb();
+    for (i = 0; i < nr_pages; i++) {
+        char* p;
+        char* end;
+
+        if (!is_testable(start_pfn + i))
+            continue;
+
+        p = page_address(pfn_to_page(start_pfn + i));
+        end = p + PAGE_SIZE;
+        for (; p < end; p += line)
+            clflush(p);
+    }
+    mb();
+#endif
+}
+
+/*
+ * Test the frames start_pfn..start_pfn + nr_pages - 1 (a chunk) with all
+ * patterns. bad[i] is set for the bad frame start_pfn + i.
+ *
+ * Returns the number of tested frames.
+ */
+static unsigned long test_chunk(unsigned long start_pfn, unsigned long nr_pages, unsigned char* bad) {
+    unsigned long tested = 0;
+    unsigned long i;
+    int pattern;
+
+    for (i = 0; i < nr_pages; i++)
+        if (is_testable(start_pfn + i))
+            tested++;
+
+    for (pattern = 0; pattern < NUM_PATTERNS; pattern++) {
+        for (i = 0; i < nr_pages; i++) {
+            unsigned long* word;
+            unsigned long* end;
+
+            if (!is_testable(start_pfn + i))
+                continue;
+
+            word = page_address(pfn_to_page(start_pfn + i));
+            end = word + PAGE_SIZE / sizeof (unsigned long);
+            for (; word < end; word++)
+                *word = pattern_value(pattern, word);
+        }
+
+        /* Verify only after the whole chunk has been written and flushed */
+        flush_chunk(start_pfn, nr_pages);
+
+        for (i = 0; i < nr_pages; i++) {
+            unsigned long* word;
+            unsigned long* end;
+
+            if (!is_testable(start_pfn + i) || bad[i])
+                continue;
+
+            word = page_address(pfn_to_page(start_pfn + i));
+            end = word + PAGE_SIZE / sizeof (unsigned long);
+            for (; word < end; word++) {
+                if (unlikely(*word != pattern_value(pattern, word))) {
+                    bad[i] = 1;
+                    break;
+                }
+            }
+        }
+
+        cond_resched();
+    }
+
+    if (hotplug_test_fail_pfn >= start_pfn && hotplug_test_fail_pfn < start_pfn + nr_pages && is_testable(hotplug_test_fail_pfn))
+        bad[hotplug_test_fail_pfn - start_pfn] = 1;
+
+    return tested;
+}
+
+/*
+ * Test the block and mark its bad frames. hotplug_test_mutex must be held.
+ *
+ * Returns the number of bad frames.
+ */
+static unsigned long test_block(struct tested_block* block) {
+    unsigned char* bad;
+    unsigned long chunk_pfn;
+    u64 start_ns = claim_stats_start();
+
+    bad = kzalloc(HOTPLUG_TEST_CHUNK_PAGES, GFP_KERNEL);
+    if (!bad)
+        return 0;
+
+    for (chunk_pfn = block->start_pfn; chunk_pfn < block->start_pfn + block->nr_pages; chunk_pfn += HOTPLUG_TEST_CHUNK_PAGES) {
+        unsigned long nr_pages = min((unsigned long) HOTPLUG_TEST_CHUNK_PAGES, block->start_pfn + block->nr_pages - chunk_pfn);
+        unsigned long i;
+
+        memset(bad, 0, HOTPLUG_TEST_CHUNK_PAGES);
+        block->pages_tested += test_chunk(chunk_pfn, nr_pages, bad);
+
+        for (i = 0; i < nr_pages; i++) {
+            if (!bad[i])
+                continue;
+
+            printk(KERN_WARNING "hotplug_test: pfn %#lx is bad, it is not onlined\n", chunk_pfn + i);
+#ifdef CONFIG_MEMORY_FAILURE
+            /* online_page() frees the frame, bad_page() silently drops poisoned frames */
+            SetPageHWPoison(pfn_to_page(chunk_pfn + i));
+#endif
+            block->pages_bad++;
+            if (num_bad < HOTPLUG_TEST_MAX_BAD)
+                bad_pfns[num_bad] = chunk_pfn + i;
+            num_bad++;
+        }
+    }
+
+    kfree(bad);
+
+    block->duration_ns = claim_stats_start() - start_ns;
+    return block->pages_bad;
+}
+
+static int hotplug_test_callback(struct notifier_block* self, unsigned long action, void* arg) {
+    struct memory_notify* mn = arg;
+    struct tested_block* block;
+    int ret = NOTIFY_OK;
+
+    if (MEM_GOING_ONLINE != action || !hotplug_test)
+        return NOTIFY_OK;
+
+    mutex_lock(&hotplug_test_mutex);
+
+    block = &tested_blocks[num_tested_blocks % HOTPLUG_TEST_MAX_BLOCKS];
+    memset(block, 0, sizeof (*block));
+    block->start_pfn = mn->start_pfn;
+    block->nr_pages = mn->nr_pages;
+
+    if (test_block(block)) {
+#ifndef CONFIG_MEMORY_FAILURE
+        /* The bad frames cannot be kept out of the allocator */
+        block->vetoed = 1;
+        ret = notifier_from_errno(-EIO);
+#endif
+    }
+
+    num_tested_blocks++;
+    blocks_tested++;
+    pages_tested += block->pages_tested;
+    pages_skipped += block->nr_pages - block->pages_tested;
+    total_duration_ns += block->duration_ns;
+
+    printk(KERN_INFO "hotplug_test: tested %lu of %lu frames at pfn %#lx in %llu ms, %lu bad%s\n",
+            block->pages_tested, block->nr_pages, block->start_pfn, div_u64(block->duration_ns, NSEC_PER_MSEC),
+            block->pages_bad, block->vetoed ? ", the block is not onlined" : "");
+
+    mutex_unlock(&hotplug_test_mutex);
+    return ret;
+}
+
+static struct notifier_block hotplug_test_nb = {
+    .notifier_call = hotplug_test_callback,
+    .priority = 0,
+};
+
+/*
+ * MB/s at which `pages` frames have been tested (each pattern writes and reads every frame)
+ */
+static unsigned long bandwidth_mb(unsigned long pages, u64 duration_ns) {
+    u64 bytes = (u64) pages * PAGE_SIZE * 2 * NUM_PATTERNS;
+
+    if (!duration_ns)
+        return 0;
+
+    return div64_u64(bytes * 1000, duration_ns);
+}
+
+static int hotplug_test_show(struct seq_file* m, void* v) {
+    unsigned long first, i;
+
+    mutex_lock(&hotplug_test_mutex);
+
+    seq_printf(m, "enabled: %d\n", hotplug_test);
+    seq_printf(m, "blocks tested: %lu\n", blocks_tested);
+    seq_printf(m, "frames tested: %lu\n", pages_tested);
+    seq_printf(m, "frames skipped: %lu\n", pages_skipped);
+    seq_printf(m, "bad frames: %lu\n", num_bad);
+    seq_printf(m, "bandwidth: %lu MB/s\n", bandwidth_mb(pages_tested, total_duration_ns));
+
+    first = num_tested_blocks > HOTPLUG_TEST_MAX_BLOCKS ? num_tested_blocks - HOTPLUG_TEST_MAX_BLOCKS : 0;
+    for (i = first; i < num_tested_blocks; i++) {
+        struct tested_block* block = &tested_blocks[i % HOTPLUG_TEST_MAX_BLOCKS];
+
+        seq_printf(m, "block %#lx %lu tested %lu bad %lu %llu ms%s\n", block->start_pfn, block->nr_pages,
+                block->pages_tested, block->pages_bad, div_u64(block->duration_ns, NSEC_PER_MSEC), block->vetoed ? " not onlined" : "");
+    }
+
+    for (i = 0; i < min(num_bad, (unsigned long) HOTPLUG_TEST_MAX_BAD); i++)
+        seq_printf(m, "bad %#lx\n", bad_pfns[i]);
+
+    mutex_unlock(&hotplug_test_mutex);
+    return 0;
+}
+
+static int hotplug_test_open(struct inode* inode, struct file* file) {
+    return single_open(file, hotplug_test_show, NULL);
+}
+
+static ssize_t hotplug_test_write(struct file* file, const char __user* buf, size_t count, loff_t* ppos) {
+    mutex_lock(&hotplug_test_mutex);
+    blocks_tested = 0;
+    pages_tested = 0;
+    pages_skipped = 0;
+    total_duration_ns = 0;
+    num_tested_blocks = 0;
+    num_bad = 0;
+    mutex_unlock(&hotplug_test_mutex);
+
+    return count;
+}
+
+static const struct file_operations hotplug_test_fops = {
+    .owner = THIS_MODULE,
+    .open = hotplug_test_open,
+    .read = seq_read,
+    .write = hotplug_test_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+int hotplug_test_init(void) {
+    int ret;
+
+    ret = register_memory_notifier(&hotplug_test_nb);
+    if (ret) {
+        printk(KERN_WARNING "hotplug_test: could not register the memory hotplug notifier: %d\n", ret);
+        return ret;
+    }
+
+    if (phys_mem_debugfs_dir)
+        hotplug_test_file = debugfs_create_file("hotplug_test", S_IRUSR | S_IWUSR, phys_mem_debugfs_dir, NULL, &hotplug_test_fops);
+
+    return 0;
+}
+
+void hotplug_test_exit(void) {
+    unregister_memory_notifier(&hotplug_test_nb);
+
+    debugfs_remove(hotplug_test_file);
+    hotplug_test_file = NULL;
+}
+
+#else /* CONFIG_MEMORY_HOTPLUG */
+
+int hotplug_test_init(void) {
+    if (hotplug_test)
+        printk(KERN_DEBUG "hotplug_test: no memory hotplug support (CONFIG_MEMORY_HOTPLUG)\n");
+    return 0;
+}
+
+void hotplug_test_exit(void) {
+}
+
+#endif /* CONFIG_MEMORY_HOTPLUG */
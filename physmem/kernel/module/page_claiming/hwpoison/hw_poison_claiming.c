@@ -31,6 +31,7 @@
 #include "phys_mem.h"           /* local definitions */
 #include "phys_mem_int.h"           /* local definitions */
 #include "page_claiming.h"           /* local definitions */
+#include "claim_stats.h"           /* local definitions */
 
 #ifdef USE_HW_POISON_IMPLEMENTATION_CLONE
 
@@ -39,12 +40,16 @@
 int soft_offline_page__clone(struct page *page, int flags);
 int unpoison_memory__clone(unsigned long pfn);
 
-inline int try_claim_page_via_hwpoison(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source) {
-  if (PageHWPoison(requested_page))
+inline int try_claim_page_via_hwpoison(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason) {
+  if (PageHWPoison(requested_page)) {
+    *failure_reason = CLAIM_FAILURE_POISONED;
     return CLAIMED_ABORT;
+  }
 
-  if(soft_offline_page__clone(requested_page,0))
+  if(soft_offline_page__clone(requested_page,0)) {
+      *failure_reason = CLAIM_FAILURE_MIGRATION;
       return CLAIMED_TRY_NEXT;
+  }
 
   /*
    * soft_offline_page does several things that we do not want
@@ -75,7 +80,7 @@ static inline bool PageCleanPageCache(struct page* page){
 #undef NONE_MUST_BE_SET
 #undef IS_COMPUND
 
-inline int try_claim_page_via_hwpoison(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source) {
+inline int try_claim_page_via_hwpoison(struct page* requested_page, unsigned int allowed_sources,struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason) {
 
   int ret = CLAIMED_TRY_NEXT;
 
@@ -87,15 +92,24 @@ inline int try_claim_page_via_hwpoison(struct page* requested_page, unsigned int
 
   if ( has_mandate ) {
    unsigned long pfn;
+   u64 start;
+   int result;
 
-  if (PageHWPoison(requested_page))
+  if (PageHWPoison(requested_page)) {
+    *failure_reason = CLAIM_FAILURE_POISONED;
     return CLAIMED_ABORT;
+  }
 
   my_dump_page(requested_page,"HW-Poison claimer: trying soft_offline_page");
 
-  if(soft_offline_page(requested_page,0))
+  start = claim_stats_enter(CLAIM_SECTION_HWPOISON_OFFLINE);
+  result = soft_offline_page(requested_page,0);
+  claim_stats_end(CLAIM_SECTION_HWPOISON_OFFLINE, start);
+
+  if(result)
     {
     my_dump_page(requested_page,"soft-offlined pfn FAILED ");
+     *failure_reason = PageLocked(requested_page) || PageWriteback(requested_page) ? CLAIM_FAILURE_BUSY : CLAIM_FAILURE_MIGRATION;
      return CLAIMED_TRY_NEXT;
     }
 
@@ -118,7 +132,11 @@ inline int try_claim_page_via_hwpoison(struct page* requested_page, unsigned int
      * - it sets the HW_POISON flag on the page
      * - it increments mce_bad_pages
      */
-    if (0 != unpoison_memory(pfn)){
+    start = claim_stats_enter(CLAIM_SECTION_HWPOISON_UNPOISON);
+    result = unpoison_memory(pfn);
+    claim_stats_end(CLAIM_SECTION_HWPOISON_UNPOISON, start);
+
+    if (0 != result){
        /* We basically lost a page frame. */
       printk(KERN_NOTICE "Lost pageframe %lux because it could be poisoned but not unpoisoned.\n", pfn);
       ret =  CLAIMED_ABORT;
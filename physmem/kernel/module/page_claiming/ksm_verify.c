@@ -0,0 +1,414 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Checksum stable KSM pages and recheck them at a low rate.
+ *
+ * See ksm_verify.h for a complete documentation!
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel.h>       /* printk() */
+#include <linux/errno.h>        /* error codes */
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/highmem.h>
+#include <linux/ksm.h>
+#include <linux/crc32c.h>
+#include <linux/hash.h>
+#include <linux/list.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>        /* cond_resched() */
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <asm/uaccess.h>
+
+#include "phys_mem.h"           /* local definitions */
+#include "phys_mem_int.h"           /* local definitions */
+#include "ksm_verify.h"           /* local definitions */
+
+static unsigned int ksm_verify_interval_ms = 1000;
+module_param(ksm_verify_interval_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(ksm_verify_interval_ms, "Pause between two runs of the KSM page verifier (0: paused)");
+
+static unsigned int ksm_verify_batch = 256;
+module_param(ksm_verify_batch, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(ksm_verify_batch, "Stable KSM pages checksummed per run of the verifier");
+
+static unsigned long ksm_verify_max_pages = 1UL << 20;
+module_param(ksm_verify_max_pages, ulong, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(ksm_verify_max_pages, "Maximum number of stable KSM pages whose checksum is kept");
+
+/* A run stops after this many pfns, even if it found fewer stable pages than the batch */
+#define KSM_VERIFY_MAX_PFNS_PER_RUN     (1UL << 16)
+
+/* Reschedule after this many pfns, KSM pages or not */
+#define KSM_VERIFY_RESCHED_PFNS         1024
+
+#define KSM_VERIFY_HASH_BITS            14
+
+/* The checksum of a stable page */
+struct ksm_checksum {
+    struct hlist_node node;
+    unsigned long pfn;
+    struct address_space* stable_node;  /* page->mapping when checksummed */
+    pgoff_t index;                      /* page->index when checksummed */
+    u32 crc;
+};
+
+/* Serialises the runs and protects everything below */
+static DEFINE_MUTEX(ksm_verify_mutex);
+
+static struct hlist_head checksums[1 << KSM_VERIFY_HASH_BITS];
+static unsigned long num_checksums;
+
+static unsigned long ksm_verify_cursor;
+static unsigned long pages_checksummed;
+static unsigned long pages_rechecked;
+static unsigned long pages_forgotten;
+static unsigned long pages_untracked;
+static unsigned long pages_raced;
+static unsigned long sweeps;
+static unsigned long num_changed;
+static unsigned long changed[KSM_VERIFY_MAX_CHANGED];
+
+static struct kmem_cache* checksum_cache;
+
+static void ksm_verify_work_fn(struct work_struct* work);
+static DECLARE_DELAYED_WORK(ksm_verify_work, ksm_verify_work_fn);
+
+static struct dentry* ksm_verify_file;
+
+/*
+ * The pfn after the highest pfn of all zones
+ */
+static unsigned long ksm_verify_end_pfn(void) {
+    unsigned long end_pfn = 0;
+    struct zone* zone;
+
+    for_each_populated_zone(zone) {
+        unsigned long zone_end_pfn = zone->zone_start_pfn + zone->spanned_pages;
+
+        if (zone_end_pfn > end_pfn)
+            end_pfn = zone_end_pfn;
+    }
+    return end_pfn;
+}
+
+static struct hlist_head* checksum_bucket(unsigned long pfn) {
+    return &checksums[hash_long(pfn, KSM_VERIFY_HASH_BITS)];
+}
+
+static struct ksm_checksum* find_checksum(unsigned long pfn) {
+    struct ksm_checksum* entry;
+    struct hlist_node* pos;
+
+    hlist_for_each_entry(entry, pos, checksum_bucket(pfn), node)
+        if (entry->pfn == pfn)
+            return entry;
+
+    return NULL;
+}
+
+static void forget_checksum(struct ksm_checksum* entry) {
+    hlist_del(&entry->node);
+    kmem_cache_free(checksum_cache, entry);
+    num_checksums--;
+}
+
+static void forget_all_checksums(void) {
+    struct ksm_checksum* entry;
+    struct hlist_node *pos, *next;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(checksums); i++)
+        hlist_for_each_entry_safe(entry, pos, next, &checksums[i], node)
+            forget_checksum(entry);
+}
+
+/*
+ * Is the page (still) the stable page `stable_node` at `index`? Stable nodes
+ * are freed with their page and reused, so the node alone does not identify
+ * a page; the index of the anonymous page that became the stable page is
+ * kept by KSM and tells a page merged anew at the same pfn apart.
+ */
+static inline int is_stable_page(struct page* page, struct address_space* stable_node, pgoff_t index) {
+    return PageKsm(page) && page->mapping == stable_node && page->index == index;
+}
+
+/*
+ * Checksum the page if it is (and stays) the stable page `stable_node` at
+ * `index`. Returns 0 on success, -EAGAIN if the page changed its identity.
+ */
+static int checksum_stable_page(struct page* page, struct address_space* stable_node, pgoff_t index, u32* crc) {
+    void* addr;
+    int ret = -EAGAIN;
+
+    if (!get_page_unless_zero(page))
+        return -EAGAIN;
+
+    if (is_stable_page(page, stable_node, index)) {
+        addr = kmap_atomic(page, KM_USER0);
+        *crc = crc32c(~0, addr, PAGE_SIZE);
+        kunmap_atomic(addr, KM_USER0);
+
+        /* Left the stable tree while being read? */
+        smp_rmb();
+        if (is_stable_page(page, stable_node, index))
+            ret = 0;
+    }
+
+    put_page(page);
+    return ret;
+}
+
+static void report_changed(unsigned long pfn, u32 expected, u32 actual) {
+    printk(KERN_ERR "ksm_verify: the content of the stable KSM page at pfn %#lx changed while it stayed merged (crc32c %08x, expected %08x)\n", pfn, actual, expected);
+
+    if (num_changed < KSM_VERIFY_MAX_CHANGED)
+        changed[num_changed] = pfn;
+    num_changed++;
+}
+
+/*
+ * Checksum or recheck one pfn. Returns 1 if a checksum has been computed.
+ * ksm_verify_mutex must be held.
+ */
+static int verify_pfn(unsigned long pfn) {
+    struct ksm_checksum* entry = num_checksums ? find_checksum(pfn) : NULL;
+    struct address_space* stable_node;
+    pgoff_t index;
+    struct page* page = pfn_to_page(pfn);
+    u32 crc, confirmed_crc;
+
+    if (!PageKsm(page)) {
+        if (entry) {
+            forget_checksum(entry);
+            pages_forgotten++;
+        }
+        return 0;
+    }
+
+    stable_node = page->mapping;
+    index = page->index;
+
+    if (entry && (entry->stable_node != stable_node || entry->index != index)) {
+        /* Freed and merged again: another page */
+        forget_checksum(entry);
+        pages_forgotten++;
+        entry = NULL;
+    }
+
+    if (!entry && num_checksums >= ksm_verify_max_pages) {
+        pages_untracked++;
+        return 0;
+    }
+
+    if (checksum_stable_page(page, stable_node, index, &crc)) {
+        pages_raced++;
+        return 1;
+    }
+
+    if (!entry) {
+        entry = kmem_cache_alloc(checksum_cache, GFP_KERNEL);
+        if (!entry) {
+            pages_untracked++;
+            return 1;
+        }
+        entry->pfn = pfn;
+        entry->stable_node = stable_node;
+        entry->index = index;
+        entry->crc = crc;
+        hlist_add_head(&entry->node, checksum_bucket(pfn));
+        num_checksums++;
+        pages_checksummed++;
+        return 1;
+    }
+
+    pages_rechecked++;
+    if (unlikely(crc != entry->crc)) {
+        /*
+         * Confirm with a second read: the page must still be the same stable
+         * page and read the same, else it is rechecked in the next sweep
+         */
+        if (checksum_stable_page(page, stable_node, index, &confirmed_crc) || confirmed_crc != crc) {
+            pages_raced++;
+            return 1;
+        }
+
+        report_changed(pfn, entry->crc, crc);
+        /* Report each change once */
+        entry->crc = crc;
+    }
+    return 1;
+}
+
+/*
+ * Verify the stable pages among the next nr_pfns pfns from the cursor, at
+ * most max_pages of them. ksm_verify_mutex must be held.
+ */
+static void ksm_verify_step(unsigned long nr_pfns, unsigned long max_pages) {
+    unsigned long end_pfn = ksm_verify_end_pfn();
+    unsigned long pfn = ksm_verify_cursor;
+    unsigned long since_resched = 0;
+
+    for (; nr_pfns && max_pages; nr_pfns--, pfn++) {
+        if (pfn >= end_pfn) {
+            pfn = 0;
+            sweeps++;
+        }
+
+        if (++since_resched >= KSM_VERIFY_RESCHED_PFNS) {
+            since_resched = 0;
+            cond_resched();
+            if (fatal_signal_pending(current))
+                break;
+        }
+
+        if (!pfn_valid(pfn))
+            continue;
+
+        if (verify_pfn(pfn))
+            max_pages--;
+    }
+
+    ksm_verify_cursor = pfn;
+}
+
+static void ksm_verify_work_fn(struct work_struct* work) {
+    unsigned int interval_ms = ksm_verify_interval_ms;
+
+    if (interval_ms) {
+        mutex_lock(&ksm_verify_mutex);
+        ksm_verify_step(KSM_VERIFY_MAX_PFNS_PER_RUN, ksm_verify_batch);
+        mutex_unlock(&ksm_verify_mutex);
+    } else {
+        /* Paused: look again whether the verifier has been resumed */
+        interval_ms = 1000;
+    }
+
+    schedule_delayed_work(&ksm_verify_work, msecs_to_jiffies(interval_ms));
+}
+
+static int ksm_verify_show(struct seq_file* m, void* v) {
+    unsigned long i;
+
+    mutex_lock(&ksm_verify_mutex);
+
+    seq_printf(m, "interval_ms: %u\n", ksm_verify_interval_ms);
+    seq_printf(m, "batch: %u\n", ksm_verify_batch);
+    seq_printf(m, "cursor: %#lx\n", ksm_verify_cursor);
+    seq_printf(m, "sweeps: %lu\n", sweeps);
+    seq_printf(m, "pages tracked: %lu\n", num_checksums);
+    seq_printf(m, "pages checksummed: %lu\n", pages_checksummed);
+    seq_printf(m, "pages rechecked: %lu\n", pages_rechecked);
+    seq_printf(m, "pages forgotten (left the stable tree): %lu\n", pages_forgotten);
+    seq_printf(m, "pages not tracked (max_pages): %lu\n", pages_untracked);
+    seq_printf(m, "pages changed identity while read: %lu\n", pages_raced);
+    seq_printf(m, "changed: %lu\n", num_changed);
+
+    for (i = 0; i < min(num_changed, (unsigned long) KSM_VERIFY_MAX_CHANGED); i++)
+        seq_printf(m, "changed %#lx\n", changed[i]);
+
+    mutex_unlock(&ksm_verify_mutex);
+    return 0;
+}
+
+static int ksm_verify_open(struct inode* inode, struct file* file) {
+    return single_open(file, ksm_verify_show, NULL);
+}
+
+static ssize_t ksm_verify_write(struct file* file, const char __user* buf, size_t count, loff_t* ppos) {
+    char kbuf[32];
+    unsigned long nr_pfns;
+
+    if (count >= sizeof (kbuf))
+        return -EINVAL;
+
+    if (copy_from_user(kbuf, buf, count))
+        return -EFAULT;
+    kbuf[count] = '\0';
+
+    /* At most one sweep */
+    nr_pfns = min(simple_strtoul(kbuf, NULL, 0), ksm_verify_end_pfn());
+
+    if (mutex_lock_interruptible(&ksm_verify_mutex))
+        return -ERESTARTSYS;
+
+    if (nr_pfns) {
+        ksm_verify_step(nr_pfns, ULONG_MAX);
+    } else {
+        forget_all_checksums();
+        ksm_verify_cursor = 0;
+        pages_checksummed = 0;
+        pages_rechecked = 0;
+        pages_forgotten = 0;
+        pages_untracked = 0;
+        pages_raced = 0;
+        sweeps = 0;
+        num_changed = 0;
+    }
+
+    mutex_unlock(&ksm_verify_mutex);
+    return count;
+}
+
+static const struct file_operations ksm_verify_fops = {
+    .owner = THIS_MODULE,
+    .open = ksm_verify_open,
+    .read = seq_read,
+    .write = ksm_verify_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+int ksm_verify_init(void) {
+#ifndef CONFIG_KSM
+    printk(KERN_NOTICE "ksm_verify: the kernel has no KSM, nothing to verify\n");
+    return 0;
+#else
+    checksum_cache = KMEM_CACHE(ksm_checksum, 0);
+    if (!checksum_cache)
+        return -ENOMEM;
+
+    if (phys_mem_debugfs_dir)
+        ksm_verify_file = debugfs_create_file("ksm_verify", S_IRUSR | S_IWUSR, phys_mem_debugfs_dir, NULL, &ksm_verify_fops);
+
+    schedule_delayed_work(&ksm_verify_work, msecs_to_jiffies(ksm_verify_interval_ms ? ksm_verify_interval_ms : 1000));
+    return 0;
+#endif
+}
+
+void ksm_verify_exit(void) {
+    if (!checksum_cache)
+        return;
+
+    cancel_delayed_work_sync(&ksm_verify_work);
+
+    debugfs_remove(ksm_verify_file);
+    ksm_verify_file = NULL;
+
+    mutex_lock(&ksm_verify_mutex);
+    forget_all_checksums();
+    mutex_unlock(&ksm_verify_mutex);
+
+    kmem_cache_destroy(checksum_cache);
+    checksum_cache = NULL;
+}
@@ -36,7 +36,7 @@
 /**
  * Try to claim page from the page-cache
  */
-int try_claim_page_in_page_cache(struct page* requested_page, unsigned int allowed_sources, struct page** allocated_page, unsigned long* actual_source) {
+int try_claim_page_in_page_cache(struct page* requested_page, unsigned int allowed_sources, struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason) {
   int ret = CLAIMED_TRY_NEXT;
 
   if ( allowed_sources & SOURCE_PAGE_CACHE) {
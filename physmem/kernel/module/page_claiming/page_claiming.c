@@ -46,6 +46,10 @@
 #include "phys_mem.h"           /* local definitions */
 #include "phys_mem_int.h"           /* local definitions */
 #include "page_claiming.h"           /* local definitions */
+#include "spare_pool.h"           /* local definitions */
+#include "dirty_writeback.h"           /* local definitions */
+#include "swap_cache.h"           /* local definitions */
+#include "claim_stats.h"           /* local definitions */
 
 
 /**
@@ -54,10 +58,52 @@
 // try_claim_method try_claim_methods[]  =  {try_claim_free_page,try_claim_free_buddy_page,try_claim_page_in_page_cache,try_claim_page_from_user_process, NULL};
 //  try_claim_method try_claim_methods[]  =  {try_claim_free_page,try_claim_free_buddy_page,try_claim_page_in_page_cache,try_claim_page_from_user_process, ignore_difficult_pages,try_claim_page_via_hwpoison,NULL};
 //  try_claim_method try_claim_methods[]  =  {try_claim_free_buddy_page,NULL};
-try_claim_method try_claim_methods[] = {try_claim_free_buddy_page, ignore_difficult_pages, try_claim_page_via_hwpoison, NULL};
+try_claim_method try_claim_methods[] = {try_claim_spare_page, try_claim_free_buddy_page, ignore_difficult_pages, try_claim_dirty_page_cache, try_claim_swap_cache_page, try_claim_page_via_hwpoison, NULL};
 //  try_claim_method try_claim_methods[]  =  {ignore_difficult_pages,try_claim_page_via_hwpoison, try_any_page_claiming, NULL};
 //  try_claim_method try_claim_methods[]  =  { NULL};
 
+/* The costs of try_claim_methods, same order */
+struct claim_cost claim_costs[] = {
+    {.name = "spare_pool"},
+    {.name = "free_buddy"},
+    {.name = "difficult_pages"},
+    {.name = "dirty_page_cache"},
+    {.name = "swap_cache"},
+    {.name = "hwpoison"},
+    {.name = NULL},
+};
+
+/*
+ * The suggested wait before a frame is requested again, by CLAIM_FAILURE_*
+ */
+static const unsigned int retry_after_ms[CLAIM_FAILURE_NUM_REASONS] = {
+    [CLAIM_FAILURE_NONE] = 0,
+    [CLAIM_FAILURE_NOT_ALLOWED] = 60 * 1000,    /* until the frame is used differently */
+    [CLAIM_FAILURE_RACE] = 10,
+    [CLAIM_FAILURE_BUSY] = 100,                 /* I/O completes quickly */
+    [CLAIM_FAILURE_IN_USE] = 10 * 1000,
+    [CLAIM_FAILURE_MIGRATION] = 1000,
+    [CLAIM_FAILURE_UNMOVABLE] = CLAIM_RETRY_NEVER,
+    [CLAIM_FAILURE_POISONED] = CLAIM_RETRY_NEVER,
+    [CLAIM_FAILURE_PROTECTED] = CLAIM_RETRY_NEVER,
+    [CLAIM_FAILURE_INVALID_PFN] = CLAIM_RETRY_NEVER,
+};
+
+/*
+ * Set the failure reason of an unclaimed frame. Without a reason from the
+ * claimers no allowed claimer felt responsible.
+ */
+static void set_failure_reason(struct phys_mem_frame_status* status, struct page* page) {
+    if (CLAIM_FAILURE_NONE == status->failure_reason) {
+        if (page && (PageSlab(page) || PageReserved(page)))
+            status->failure_reason = CLAIM_FAILURE_UNMOVABLE;
+        else
+            status->failure_reason = CLAIM_FAILURE_NOT_ALLOWED;
+    }
+
+    status->retry_after_ms = retry_after_ms[status->failure_reason];
+}
+
 //#define DEBUG_REQUEST
 
 #ifdef DEBUG_REQUEST
@@ -103,6 +149,40 @@ out:
     return ret;
 }
 
+int handle_set_layout(struct phys_mem_session* session, const struct phys_mem_layout* request) {
+    int ret = 0;
+
+    if (down_interruptible(&session->sem))
+        return -ERESTARTSYS;
+
+    if (unlikely((GET_STATE(session) != SESSION_STATE_OPEN) &&
+            (GET_STATE(session) != SESSION_STATE_CONFIGURED))) {
+
+        printk(KERN_WARNING "Session %llu: The state of the session is invalid: The Set layout IOCTL should never appear in state %i\n", session->session_id, GET_STATE(session));
+
+        ret = -EINVAL;
+        goto out;
+    }
+
+    switch (request->layout) {
+        case PHYS_MEM_LAYOUT_DENSE:
+            session->layout = PHYS_MEM_LAYOUT_DENSE;
+            session->layout_base_pfn = 0;
+            break;
+        case PHYS_MEM_LAYOUT_PFN_INDEXED:
+            session->layout = PHYS_MEM_LAYOUT_PFN_INDEXED;
+            session->layout_base_pfn = request->base_pfn;
+            break;
+        default:
+            printk(KERN_NOTICE "Session %llu: Unknown layout %lu\n", session->session_id, request->layout);
+            ret = -EINVAL;
+    }
+
+out:
+    up(&session->sem);
+    return ret;
+}
+
 int handle_request_pages(struct phys_mem_session* session, const struct phys_mem_request* request) {
     int ret = 0;
     unsigned long i;
@@ -178,11 +258,20 @@ int handle_request_pages(struct phys_mem_session* session, const struct phys_mem
              * Claiming the page is where it gets interesting
              */
             jiffies_start = get_jiffies_64();
-
+            current_pfn_status->failure_reason = CLAIM_FAILURE_NONE;
+            current_pfn_status->retry_after_ms = 0;
 
             if (unlikely(!pfn_valid(current_pfn_status->request.requested_pfn))) {
                 current_pfn_status->actual_source = SOURCE_INVALID_PFN;
+                current_pfn_status->failure_reason = CLAIM_FAILURE_INVALID_PFN;
+                set_failure_reason(current_pfn_status, NULL);
                 printk(KERN_DEBUG "Session %llu: Invalid pfn: %lu (at position #%lu)\n", session->session_id, current_pfn_status->request.requested_pfn, i);
+            } else if (unlikely(session->layout == PHYS_MEM_LAYOUT_PFN_INDEXED && current_pfn_status->request.requested_pfn < session->layout_base_pfn)) {
+                /* The frame cannot be placed in the layout */
+                current_pfn_status->actual_source = SOURCE_INVALID_PFN;
+                current_pfn_status->failure_reason = CLAIM_FAILURE_INVALID_PFN;
+                set_failure_reason(current_pfn_status, NULL);
+                printk(KERN_DEBUG "Session %llu: Invalid pfn: %lu (at position #%lu) is below the base pfn %lu of the layout\n", session->session_id, current_pfn_status->request.requested_pfn, i, session->layout_base_pfn);
             } else {
                 struct page* requested_page = pfn_to_page(current_pfn_status->request.requested_pfn);
 
@@ -208,9 +297,24 @@ int handle_request_pages(struct phys_mem_session* session, const struct phys_mem
                 while (CLAIMED_TRY_NEXT == claim_method_result) {
                     claim_method = try_claim_methods[claim_method_idx];
 
-                    if (claim_method)
-                        claim_method_result = claim_method(requested_page, current_pfn_status->request.allowed_sources, &allocated_page, &current_pfn_status->actual_source);
-                    else
+                    if (claim_method) {
+                        unsigned int earlier_reason = current_pfn_status->failure_reason;
+                        u64 claim_start = claim_stats_start();
+
+                        current_pfn_status->failure_reason = CLAIM_FAILURE_NONE;
+                        claim_method_result = claim_method(requested_page, current_pfn_status->request.allowed_sources, &allocated_page, &current_pfn_status->actual_source, &current_pfn_status->failure_reason);
+
+                        if (CLAIMED_TRY_NEXT != claim_method_result || CLAIM_FAILURE_NONE != current_pfn_status->failure_reason) {
+                            atomic_long_inc(&claim_costs[claim_method_idx].attempts);
+                            atomic64_add(claim_stats_start() - claim_start, &claim_costs[claim_method_idx].total_ns);
+                            if (CLAIMED_SUCCESSFULLY == claim_method_result)
+                                atomic_long_inc(&claim_costs[claim_method_idx].claimed);
+                        }
+
+                        /* Keep the reason of an earlier claimer if this one passed */
+                        if (CLAIM_FAILURE_NONE == current_pfn_status->failure_reason)
+                            current_pfn_status->failure_reason = earlier_reason;
+                    } else
                         claim_method_result = CLAIMED_ABORT;
 
                     claim_method_idx++;
@@ -218,17 +322,34 @@ int handle_request_pages(struct phys_mem_session* session, const struct phys_mem
 
                 if (CLAIMED_SUCCESSFULLY == claim_method_result) {
 
+                    /* An earlier claimer may have reported why it could not claim the frame */
+                    current_pfn_status->failure_reason = CLAIM_FAILURE_NONE;
                     current_pfn_status->pfn = page_to_pfn(allocated_page);
                     current_pfn_status->page = allocated_page;
-                    current_pfn_status->vma_offset_of_first_byte = current_offset_in_vma;
-                    current_offset_in_vma += PAGE_SIZE;
+
+                    if (session->layout == PHYS_MEM_LAYOUT_PFN_INDEXED) {
+                        if (likely(current_pfn_status->pfn >= session->layout_base_pfn)) {
+                            current_pfn_status->vma_offset_of_first_byte = ((unsigned long long) (current_pfn_status->pfn - session->layout_base_pfn)) << PAGE_SHIFT;
+                            if (current_pfn_status->vma_offset_of_first_byte + PAGE_SIZE > session->vma_size)
+                                session->vma_size = current_pfn_status->vma_offset_of_first_byte + PAGE_SIZE;
+                        } else {
+                            /* The claimer returned a replacement frame that cannot be placed: keep it claimed, but never map it */
+                            current_pfn_status->vma_offset_of_first_byte = 0;
+                            current_pfn_status->actual_source |= SOURCE_ERROR_NOT_MAPPABLE;
+                        }
+                    } else {
+                        current_pfn_status->vma_offset_of_first_byte = current_offset_in_vma;
+                        current_offset_in_vma += PAGE_SIZE;
+                        session->vma_size = current_offset_in_vma;
+                    }
                     printk(KERN_DEBUG "Session %llu: Claimed pfn %lx (requested page is %lx). Method: %lx. Page-Count %i \n", session->session_id, page_to_pfn(requested_page), current_pfn_status->request.requested_pfn, current_pfn_status->actual_source, page_count(requested_page));
                 } else {
                     /* Nothing to do*/
                     current_pfn_status->page = NULL;
                     current_pfn_status->pfn = 0;
                     current_pfn_status->vma_offset_of_first_byte = 0;
-                    printk(KERN_DEBUG "Session %llu: NOT Claimed pfn %lx (page is for %lx). Method: %lx. Page-Count %i \n", session->session_id, current_pfn_status->request.requested_pfn, page_to_pfn(requested_page), current_pfn_status->actual_source, page_count(requested_page));
+                    set_failure_reason(current_pfn_status, requested_page);
+                    printk(KERN_DEBUG "Session %llu: NOT Claimed pfn %lx (page is for %lx). Method: %lx. Reason: %u, retry after %u ms. Page-Count %i \n", session->session_id, current_pfn_status->request.requested_pfn, page_to_pfn(requested_page), current_pfn_status->actual_source, current_pfn_status->failure_reason, current_pfn_status->retry_after_ms, page_count(requested_page));
                 }
 
             }
@@ -240,6 +361,9 @@ int handle_request_pages(struct phys_mem_session* session, const struct phys_mem
         }
     }
 
+    dirty_writeback_submit();
+    swap_writeback_submit();
+
     SET_STATE(session, SESSION_STATE_CONFIGURED);
 
 out:
@@ -248,6 +372,8 @@ out:
 
 out_to_open:
     printk(KERN_NOTICE "The Request IOCTL could not be completed!\n");
+    dirty_writeback_submit();
+    swap_writeback_submit();
     free_page_stati(session);
 
     SET_STATE(session, SESSION_STATE_OPEN);
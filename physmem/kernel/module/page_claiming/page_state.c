@@ -0,0 +1,217 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * The extended page state of a pfn range.
+ *
+ * See 'Page state' in phys_mem.h for a complete documentation!
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>       /* printk() */
+#include <linux/errno.h>        /* error codes */
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/ksm.h>
+#include <linux/hugetlb.h>
+#include <linux/sched.h>        /* cond_resched() */
+#include <asm/uaccess.h>
+
+#include "phys_mem.h"           /* local definitions */
+#include "phys_mem_int.h"           /* local definitions */
+#include "page_alloc_clone.h"           /* local definitions */
+#include "page_state.h"           /* local definitions */
+
+/* The records of a batch are taken under one zone->lock */
+#define PAGE_STATE_BATCH        (PAGE_SIZE / sizeof (struct phys_mem_page_state))
+
+/*
+ * The bits of /proc/kpageflags, see fs/proc/page.c
+ */
+#define KPF_LOCKED              0
+#define KPF_ERROR               1
+#define KPF_REFERENCED          2
+#define KPF_UPTODATE            3
+#define KPF_DIRTY               4
+#define KPF_LRU                 5
+#define KPF_ACTIVE              6
+#define KPF_SLAB                7
+#define KPF_WRITEBACK           8
+#define KPF_RECLAIM             9
+#define KPF_BUDDY               10
+#define KPF_MMAP                11
+#define KPF_ANON                12
+#define KPF_SWAPCACHE           13
+#define KPF_SWAPBACKED          14
+#define KPF_COMPOUND_HEAD       15
+#define KPF_COMPOUND_TAIL       16
+#define KPF_HUGE                17
+#define KPF_UNEVICTABLE         18
+#define KPF_HWPOISON            19
+#define KPF_NOPAGE              20
+#define KPF_KSM                 21
+
+static inline u64 kpf_copy_bit(u64 kflags, int ubit, int kbit) {
+    return ((kflags >> kbit) & 1) << ubit;
+}
+
+/*
+ * This is a copy of 'get_uflags' from fs/proc/page.c, which is static.
+ */
+static u64 get_uflags__clone(struct page* page) {
+    u64 k = page->flags;
+    u64 u = 0;
+
+    if (page_mapped(page))
+        u |= 1 << KPF_MMAP;
+    if (PageAnon(page))
+        u |= 1 << KPF_ANON;
+    if (PageKsm(page))
+        u |= 1 << KPF_KSM;
+
+    if (PageHead(page))
+        u |= 1 << KPF_COMPOUND_HEAD;
+    if (PageTail(page))
+        u |= 1 << KPF_COMPOUND_TAIL;
+    if (PageHuge(page))
+        u |= 1 << KPF_HUGE;
+
+    u |= kpf_copy_bit(k, KPF_LOCKED, PG_locked);
+    u |= kpf_copy_bit(k, KPF_SLAB, PG_slab);
+    u |= kpf_copy_bit(k, KPF_BUDDY, PG_buddy);
+    u |= kpf_copy_bit(k, KPF_ERROR, PG_error);
+    u |= kpf_copy_bit(k, KPF_DIRTY, PG_dirty);
+    u |= kpf_copy_bit(k, KPF_UPTODATE, PG_uptodate);
+    u |= kpf_copy_bit(k, KPF_WRITEBACK, PG_writeback);
+    u |= kpf_copy_bit(k, KPF_LRU, PG_lru);
+    u |= kpf_copy_bit(k, KPF_REFERENCED, PG_referenced);
+    u |= kpf_copy_bit(k, KPF_ACTIVE, PG_active);
+    u |= kpf_copy_bit(k, KPF_RECLAIM, PG_reclaim);
+    u |= kpf_copy_bit(k, KPF_SWAPCACHE, PG_swapcache);
+    u |= kpf_copy_bit(k, KPF_SWAPBACKED, PG_swapbacked);
+    u |= kpf_copy_bit(k, KPF_UNEVICTABLE, PG_unevictable);
+#ifdef CONFIG_MEMORY_FAILURE
+    u |= kpf_copy_bit(k, KPF_HWPOISON, PG_hwpoison);
+#endif
+
+    return u;
+}
+
+/*
+ * The zone->lock of the frame's zone is held, if the frame exists.
+ */
+static void fill_page_state(unsigned long pfn, struct phys_mem_page_state* state) {
+    struct page* page;
+
+    if (!pfn_valid(pfn)) {
+        state->flags = 1ULL << KPF_NOPAGE;
+        state->count = 0;
+        state->buddy_order = PHYS_MEM_PAGE_STATE_NONE;
+        state->migratetype = PHYS_MEM_PAGE_STATE_NONE;
+        state->zone = PHYS_MEM_PAGE_STATE_NONE;
+        state->node = PHYS_MEM_PAGE_STATE_NONE;
+        return;
+    }
+
+    page = pfn_to_page(pfn);
+
+    state->flags = get_uflags__clone(page);
+    state->count = page_mapcount(page);
+    state->buddy_order = PageBuddy(page) ? page_order__clone(page) : PHYS_MEM_PAGE_STATE_NONE;
+    state->migratetype = get_pageblock_migratetype__clone(page);
+    state->zone = page_zonenum(page);
+    state->node = page_to_nid(page);
+}
+
+/*
+ * Fill states[0..num_pfns), switching zone->lock when the zone changes.
+ */
+static void fill_page_states(unsigned long start_pfn, unsigned long num_pfns, struct phys_mem_page_state* states) {
+    struct zone* locked = NULL;
+    unsigned long flags = 0;
+    unsigned long i;
+
+    for (i = 0; i < num_pfns; i++) {
+        unsigned long pfn = start_pfn + i;
+        struct zone* zone = pfn_valid(pfn) ? page_zone(pfn_to_page(pfn)) : NULL;
+
+        if (zone != locked) {
+            if (locked)
+                spin_unlock_irqrestore(&locked->lock, flags);
+            if (zone)
+                spin_lock_irqsave(&zone->lock, flags);
+            locked = zone;
+        }
+
+        fill_page_state(pfn, &states[i]);
+    }
+
+    if (locked)
+        spin_unlock_irqrestore(&locked->lock, flags);
+}
+
+int handle_page_state(struct phys_mem_session* session, const struct phys_mem_page_state_request* request) {
+    struct phys_mem_page_state* batch;
+    unsigned long done = 0;
+    int ret = 0;
+
+    if (request->num_pfns > INT_MAX || request->num_pfns > ULONG_MAX / sizeof (struct phys_mem_page_state))
+        return -EINVAL;
+
+    if (!access_ok(VERIFY_WRITE, request->states, request->num_pfns * sizeof (struct phys_mem_page_state)))
+        return -EFAULT;
+
+    if (down_interruptible(&session->sem))
+        return -ERESTARTSYS;
+
+    if (unlikely((GET_STATE(session) != SESSION_STATE_OPEN) &&
+            (GET_STATE(session) != SESSION_STATE_CONFIGURED))) {
+
+        printk(KERN_WARNING "Session %llu: The state of the session is invalid: The Page state IOCTL should never appear in state %i\n", session->session_id, GET_STATE(session));
+
+        up(&session->sem);
+        return -EINVAL;
+    }
+
+    batch = (struct phys_mem_page_state*) __get_free_page(GFP_KERNEL);
+    if (!batch) {
+        up(&session->sem);
+        return -ENOMEM;
+    }
+
+    while (done < request->num_pfns) {
+        unsigned long n = min(request->num_pfns - done, (unsigned long) PAGE_STATE_BATCH);
+
+        fill_page_states(request->start_pfn + done, n, batch);
+
+        if (copy_to_user(request->states + done, batch, n * sizeof (struct phys_mem_page_state))) {
+            printk(KERN_DEBUG "Session %llu: page state: copy_to_user failed.\n", session->session_id);
+            ret = -EFAULT;
+            goto out;
+        }
+
+        done += n;
+        cond_resched();
+    }
+
+    ret = done;
+
+out:
+    free_page((unsigned long) batch);
+    up(&session->sem);
+    return ret;
+}
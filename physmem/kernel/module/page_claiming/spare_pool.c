@@ -0,0 +1,258 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Whole-block claiming: the pool of parked spare frames.
+ *
+ * See spare_pool.h for a complete documentation!
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel.h>       /* printk() */
+#include <linux/errno.h>        /* error codes */
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/bitops.h>
+#include <linux/jiffies.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include "phys_mem.h"           /* local definitions */
+#include "phys_mem_int.h"           /* local definitions */
+#include "page_claiming.h"           /* local definitions */
+#include "spare_pool.h"           /* local definitions */
+
+int whole_block_order = 9;
+
+/* whole_block_order is writable at runtime: reject orders the buddy allocator does not have */
+static int set_whole_block_order(const char* val, struct kernel_param* kp) {
+    long order;
+
+    if (strict_strtol(val, 0, &order) || order < 0 || order >= MAX_ORDER)
+        return -EINVAL;
+
+    whole_block_order = order;
+    return 0;
+}
+
+module_param_call(whole_block_order, set_whole_block_order, param_get_int, &whole_block_order, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(whole_block_order, "Claim free blocks of at least this order as a whole instead of splitting them (0: disabled)");
+
+static unsigned int spare_pool_timeout_ms = 5000;
+module_param(spare_pool_timeout_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(spare_pool_timeout_ms, "Release parked spare frames that have not been requested after this time");
+
+/*
+ * A claimed block. Bit i of `spare` is set while the frame start_pfn + i is
+ * parked.
+ */
+struct spare_block {
+    struct list_head list;
+    unsigned long start_pfn;
+    unsigned int order;
+    unsigned long parked_at;            /* jiffies */
+    unsigned long num_spare;
+    unsigned long spare[0];
+};
+
+static LIST_HEAD(spare_blocks);
+static DEFINE_SPINLOCK(spare_pool_lock);
+
+static void spare_pool_expire(struct work_struct* work);
+static DECLARE_DELAYED_WORK(spare_pool_work, spare_pool_expire);
+
+static atomic_long_t blocks_claimed = ATOMIC_LONG_INIT(0);
+static atomic_long_t frames_parked = ATOMIC_LONG_INIT(0);
+static atomic_long_t frames_handed_out = ATOMIC_LONG_INIT(0);
+static atomic_long_t frames_released = ATOMIC_LONG_INIT(0);
+
+static struct dentry* spare_pool_file;
+
+/*
+ * Give all parked frames of the (unlinked) block back to the buddy allocator
+ */
+static void release_block(struct spare_block* block) {
+    unsigned long nr_pages = 1UL << block->order;
+    unsigned long i;
+
+    for (i = find_first_bit(block->spare, nr_pages); i < nr_pages; i = find_next_bit(block->spare, nr_pages, i + 1)) {
+        __free_pages(pfn_to_page(block->start_pfn + i), 0);
+        atomic_long_inc(&frames_released);
+    }
+
+    kfree(block);
+}
+
+void spare_pool_add_block(struct page* head, unsigned int order, struct page* claimed, const unsigned long* bad) {
+    unsigned long nr_pages = 1UL << order;
+    unsigned long start_pfn = page_to_pfn(head);
+    unsigned long claimed_pfn = page_to_pfn(claimed);
+    struct spare_block* block;
+    unsigned long i;
+
+    block = kzalloc(sizeof (struct spare_block) + BITS_TO_LONGS(nr_pages) * sizeof (unsigned long), GFP_KERNEL);
+    if (!block) {
+        /* Degrade to claiming a single frame */
+        for (i = 0; i < nr_pages; i++)
+            if (start_pfn + i != claimed_pfn && !test_bit(i, bad))
+                __free_pages(head + i, 0);
+        return;
+    }
+
+    INIT_LIST_HEAD(&block->list);
+    block->start_pfn = start_pfn;
+    block->order = order;
+    block->parked_at = jiffies;
+
+    for (i = 0; i < nr_pages; i++) {
+        if (start_pfn + i != claimed_pfn && !test_bit(i, bad)) {
+            set_bit(i, block->spare);
+            block->num_spare++;
+        }
+    }
+
+    atomic_long_inc(&blocks_claimed);
+    atomic_long_add(block->num_spare, &frames_parked);
+
+    printk(KERN_DEBUG "spare_pool: claimed the order %u block at pfn %#lx for pfn %#lx, %lu frames parked\n", order, start_pfn, claimed_pfn, block->num_spare);
+
+    spin_lock(&spare_pool_lock);
+    list_add_tail(&block->list, &spare_blocks);
+    spin_unlock(&spare_pool_lock);
+
+    schedule_delayed_work(&spare_pool_work, msecs_to_jiffies(spare_pool_timeout_ms));
+}
+
+int try_claim_spare_page(struct page* requested_page, unsigned int allowed_sources, struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason) {
+    unsigned long pfn = page_to_pfn(requested_page);
+    struct spare_block* block;
+    struct spare_block* empty = NULL;
+    int ret = CLAIMED_TRY_NEXT;
+
+    if (!(allowed_sources & SOURCE_FREE_BUDDY_PAGE) || list_empty(&spare_blocks))
+        return CLAIMED_TRY_NEXT;
+
+    spin_lock(&spare_pool_lock);
+    list_for_each_entry(block, &spare_blocks, list) {
+        if (pfn < block->start_pfn || pfn >= block->start_pfn + (1UL << block->order))
+            continue;
+
+        if (test_and_clear_bit(pfn - block->start_pfn, block->spare)) {
+            *allocated_page = requested_page;
+            *actual_source = SOURCE_FREE_BUDDY_PAGE;
+            ret = CLAIMED_SUCCESSFULLY;
+
+            if (0 == --block->num_spare) {
+                list_del(&block->list);
+                empty = block;
+            }
+        }
+        break;
+    }
+    spin_unlock(&spare_pool_lock);
+
+    if (CLAIMED_SUCCESSFULLY == ret)
+        atomic_long_inc(&frames_handed_out);
+
+    kfree(empty);
+    return ret;
+}
+
+/*
+ * Release the frames of all blocks parked longer than spare_pool_timeout_ms.
+ */
+static void spare_pool_expire(struct work_struct* work) {
+    unsigned long timeout = msecs_to_jiffies(spare_pool_timeout_ms);
+    struct spare_block *block, *next;
+    LIST_HEAD(expired);
+    int pending;
+
+    spin_lock(&spare_pool_lock);
+    list_for_each_entry_safe(block, next, &spare_blocks, list) {
+        if (time_after_eq(jiffies, block->parked_at + timeout))
+            list_move(&block->list, &expired);
+    }
+    pending = !list_empty(&spare_blocks);
+    spin_unlock(&spare_pool_lock);
+
+    list_for_each_entry_safe(block, next, &expired, list) {
+        list_del(&block->list);
+        release_block(block);
+    }
+
+    if (pending)
+        schedule_delayed_work(&spare_pool_work, timeout);
+}
+
+static int spare_pool_show(struct seq_file* m, void* v) {
+    struct spare_block* block;
+    unsigned long num_blocks = 0, num_spare = 0;
+
+    spin_lock(&spare_pool_lock);
+    list_for_each_entry(block, &spare_blocks, list) {
+        num_blocks++;
+        num_spare += block->num_spare;
+    }
+    spin_unlock(&spare_pool_lock);
+
+    seq_printf(m, "whole_block_order: %d\n", whole_block_order);
+    seq_printf(m, "timeout_ms: %u\n", spare_pool_timeout_ms);
+    seq_printf(m, "blocks parked: %lu\n", num_blocks);
+    seq_printf(m, "frames parked: %lu\n", num_spare);
+    seq_printf(m, "total blocks claimed: %ld\n", atomic_long_read(&blocks_claimed));
+    seq_printf(m, "total frames parked: %ld\n", atomic_long_read(&frames_parked));
+    seq_printf(m, "total frames handed out: %ld\n", atomic_long_read(&frames_handed_out));
+    seq_printf(m, "total frames released: %ld\n", atomic_long_read(&frames_released));
+    return 0;
+}
+
+static int spare_pool_open(struct inode* inode, struct file* file) {
+    return single_open(file, spare_pool_show, NULL);
+}
+
+static const struct file_operations spare_pool_fops = {
+    .owner = THIS_MODULE,
+    .open = spare_pool_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+int spare_pool_init(void) {
+    if (phys_mem_debugfs_dir)
+        spare_pool_file = debugfs_create_file("spare_pool", S_IRUSR, phys_mem_debugfs_dir, NULL, &spare_pool_fops);
+
+    return 0;
+}
+
+void spare_pool_exit(void) {
+    struct spare_block *block, *next;
+
+    cancel_delayed_work_sync(&spare_pool_work);
+
+    list_for_each_entry_safe(block, next, &spare_blocks, list) {
+        list_del(&block->list);
+        release_block(block);
+    }
+
+    debugfs_remove(spare_pool_file);
+    spare_pool_file = NULL;
+}
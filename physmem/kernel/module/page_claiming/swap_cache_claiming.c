@@ -0,0 +1,365 @@
+/*
+    Copyright (C) 2010  Jens Neuhalfen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Claiming unmapped swap-cache pages.
+ *
+ * See swap_cache.h for a complete documentation!
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel.h>       /* printk() */
+#include <linux/errno.h>        /* error codes */
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/swap.h>
+#include <linux/writeback.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include "phys_mem.h"           /* local definitions */
+#include "phys_mem_int.h"           /* local definitions */
+#include "page_claiming.h"           /* local definitions */
+#include "claim_stats.h"           /* local definitions */
+#include "swap_cache.h"           /* local definitions */
+
+static unsigned long swap_writeback_max_inflight = 1024;
+module_param(swap_writeback_max_inflight, ulong, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(swap_writeback_max_inflight, "Maximum number of dirty swap-cache pages queued or under writeback for the claimer (0: no writeback)");
+
+struct swap_batch {
+    struct work_struct work;
+    u64 queued_ns;
+    unsigned long num_pages;
+    struct page* pages[0];              /* each holds a reference */
+};
+
+/* The pages queued by the running Request-Pages commands, each holds a reference */
+static struct page* pending[SWAP_WRITEBACK_MAX_BATCH];
+static unsigned long num_pending;
+static DEFINE_SPINLOCK(pending_lock);
+
+/* Pages queued or under writeback */
+static atomic_long_t inflight = ATOMIC_LONG_INIT(0);
+
+static atomic_long_t pages_dropped = ATOMIC_LONG_INIT(0);
+static atomic_long_t pages_queued = ATOMIC_LONG_INIT(0);
+static atomic_long_t pages_refused = ATOMIC_LONG_INIT(0);
+static atomic_long_t batches_written = ATOMIC_LONG_INIT(0);
+static atomic_long_t pages_written = ATOMIC_LONG_INIT(0);
+static atomic_long_t write_errors = ATOMIC_LONG_INIT(0);
+static atomic64_t total_latency_ns = ATOMIC64_INIT(0);
+static u64 max_latency_ns;                 /* updated racy, good enough for a statistic */
+
+static struct dentry* swap_cache_file;
+
+/* The writeback runs here and not on keventd: it waits for the I/O */
+static struct workqueue_struct* swap_writeback_wq;
+
+/*
+ * Queue the locked page for writeback, passing on the reference of the
+ * caller. Returns 0 if the page is queued.
+ */
+static int queue_dirty_swap_page(struct page* page) {
+    int ret = -EBUSY;
+
+    if (!swap_writeback_wq)
+        goto out_refused_now;
+
+    if (atomic_long_inc_return(&inflight) > swap_writeback_max_inflight)
+        goto out_refused;
+
+    spin_lock(&pending_lock);
+    if (num_pending < SWAP_WRITEBACK_MAX_BATCH) {
+        pending[num_pending++] = page;
+        ret = 0;
+    }
+    spin_unlock(&pending_lock);
+
+    if (!ret) {
+        atomic_long_inc(&pages_queued);
+        return 0;
+    }
+
+out_refused:
+    atomic_long_dec(&inflight);
+out_refused_now:
+    atomic_long_inc(&pages_refused);
+    return ret;
+}
+
+/*
+ * Drop the locked, clean and unmapped page from the swap cache. The caller
+ * holds a reference, which is the only one left on success.
+ */
+static int drop_clean_swap_page(struct page* page, unsigned int* failure_reason) {
+    swp_entry_t swap;
+
+    if (isolate_lru_page(page)) {
+        *failure_reason = CLAIM_FAILURE_RACE;
+        return CLAIMED_TRY_NEXT;
+    }
+
+    spin_lock_irq(&swapper_space.tree_lock);
+
+    /* The swap cache, the isolation and the caller: nobody else may look */
+    if (!page_freeze_refs(page, 3)) {
+        spin_unlock_irq(&swapper_space.tree_lock);
+        putback_lru_page(page);
+        *failure_reason = CLAIM_FAILURE_IN_USE;
+        return CLAIMED_TRY_NEXT;
+    }
+
+    if (unlikely(PageDirty(page) || page_mapped(page))) {
+        page_unfreeze_refs(page, 3);
+        spin_unlock_irq(&swapper_space.tree_lock);
+        putback_lru_page(page);
+        *failure_reason = CLAIM_FAILURE_RACE;
+        return CLAIMED_TRY_NEXT;
+    }
+
+    swap.val = page_private(page);
+    __delete_from_swap_cache(page);
+    spin_unlock_irq(&swapper_space.tree_lock);
+    swapcache_free(swap, page);
+
+    page_unfreeze_refs(page, 1);
+
+    ClearPageActive(page);
+    ClearPageUnevictable(page);
+    if (PageAnon(page))
+        page->mapping = NULL;
+
+    atomic_long_inc(&pages_dropped);
+    return CLAIMED_SUCCESSFULLY;
+}
+
+int try_claim_swap_cache_page(struct page* requested_page, unsigned int allowed_sources, struct page** allocated_page, unsigned long* actual_source, unsigned int* failure_reason) {
+    int ret = CLAIMED_TRY_NEXT;
+
+    if (!(allowed_sources & SOURCE_SWAP_CACHE) || !PageSwapCache(requested_page))
+        return CLAIMED_TRY_NEXT;
+
+    if (!get_page_unless_zero(requested_page)) {
+        *failure_reason = CLAIM_FAILURE_RACE;
+        return CLAIMED_TRY_NEXT;
+    }
+
+    if (!trylock_page(requested_page)) {
+        *failure_reason = CLAIM_FAILURE_BUSY;
+        goto out_put;
+    }
+
+    if (!PageSwapCache(requested_page)) {
+        *failure_reason = CLAIM_FAILURE_RACE;
+    } else if (page_mapped(requested_page)) {
+        /* Swapped in and in use */
+        *failure_reason = CLAIM_FAILURE_IN_USE;
+    } else if (PageWriteback(requested_page)) {
+        *failure_reason = CLAIM_FAILURE_BUSY;
+    } else if (PageDirty(requested_page)) {
+        /* The swap copy is stale: write it first */
+        *failure_reason = CLAIM_FAILURE_BUSY;
+        if (swap_writeback_max_inflight && !queue_dirty_swap_page(requested_page)) {
+            unlock_page(requested_page);
+            return CLAIMED_TRY_NEXT;
+        }
+    } else {
+        ret = drop_clean_swap_page(requested_page, failure_reason);
+    }
+
+    unlock_page(requested_page);
+
+    if (CLAIMED_SUCCESSFULLY == ret) {
+        /* Our reference is the claim */
+        *allocated_page = requested_page;
+        *actual_source = SOURCE_SWAP_CACHE;
+        return ret;
+    }
+
+out_put:
+    put_page(requested_page);
+    return ret;
+}
+
+static int compare_swap_slots(const void* a, const void* b) {
+    unsigned long x = page_private(*(struct page**) a);
+    unsigned long y = page_private(*(struct page**) b);
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/*
+ * Write a queued page, like pageout() does. Returns 1 if the I/O has been
+ * started.
+ */
+static int write_swap_page(struct page* page) {
+    struct writeback_control wbc = {
+        .sync_mode = WB_SYNC_NONE,
+        .nr_to_write = SWAP_CLUSTER_MAX,
+        .range_start = 0,
+        .range_end = LLONG_MAX,
+        .nonblocking = 1,
+        .for_reclaim = 1,
+    };
+
+    lock_page(page);
+
+    if (!PageSwapCache(page) || page_mapped(page) || PageWriteback(page) || !clear_page_dirty_for_io(page)) {
+        unlock_page(page);
+        return 0;
+    }
+
+    /* Unlocks the page */
+    if (swap_writepage(page, &wbc)) {
+        atomic_long_inc(&write_errors);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Write back a batch in swap slot order, then wait for it.
+ */
+static void swap_batch_work(struct work_struct* work) {
+    struct swap_batch* batch = container_of(work, struct swap_batch, work);
+    unsigned long i;
+    u64 latency_ns;
+
+    sort(batch->pages, batch->num_pages, sizeof (struct page*), compare_swap_slots, NULL);
+
+    for (i = 0; i < batch->num_pages; i++)
+        atomic_long_add(write_swap_page(batch->pages[i]), &pages_written);
+
+    for (i = 0; i < batch->num_pages; i++) {
+        wait_on_page_writeback(batch->pages[i]);
+        put_page(batch->pages[i]);
+    }
+
+    latency_ns = claim_stats_start() - batch->queued_ns;
+    atomic64_add(latency_ns, &total_latency_ns);
+    if (latency_ns > max_latency_ns)
+        max_latency_ns = latency_ns;
+    atomic_long_inc(&batches_written);
+
+    atomic_long_sub(batch->num_pages, &inflight);
+    kfree(batch);
+}
+
+void swap_writeback_submit(void) {
+    struct swap_batch* batch;
+
+    if (!num_pending)
+        return;
+
+    /* Without a batch the pages stay queued until the next command */
+    batch = kmalloc(sizeof (struct swap_batch) + SWAP_WRITEBACK_MAX_BATCH * sizeof (struct page*), GFP_KERNEL);
+    if (!batch)
+        return;
+
+    spin_lock(&pending_lock);
+    memcpy(batch->pages, pending, num_pending * sizeof (struct page*));
+    batch->num_pages = num_pending;
+    num_pending = 0;
+    spin_unlock(&pending_lock);
+
+    if (!batch->num_pages) {
+        kfree(batch);
+        return;
+    }
+
+    INIT_WORK(&batch->work, swap_batch_work);
+    batch->queued_ns = claim_stats_start();
+    queue_work(swap_writeback_wq, &batch->work);
+}
+
+static int swap_cache_show(struct seq_file* m, void* v) {
+    long batches = atomic_long_read(&batches_written);
+
+    seq_printf(m, "max inflight: %lu\n", swap_writeback_max_inflight);
+    seq_printf(m, "inflight: %ld\n", atomic_long_read(&inflight));
+    seq_printf(m, "clean pages dropped and claimed: %ld\n", atomic_long_read(&pages_dropped));
+    seq_printf(m, "dirty pages queued: %ld\n", atomic_long_read(&pages_queued));
+    seq_printf(m, "dirty pages refused: %ld\n", atomic_long_read(&pages_refused));
+    seq_printf(m, "batches written: %ld\n", batches);
+    seq_printf(m, "bytes written: %ld\n", atomic_long_read(&pages_written) << PAGE_SHIFT);
+    seq_printf(m, "write errors: %ld\n", atomic_long_read(&write_errors));
+    seq_printf(m, "batch latency avg: %llu us\n", batches ? div_u64(div_u64(atomic64_read(&total_latency_ns), batches), NSEC_PER_USEC) : 0ULL);
+    seq_printf(m, "batch latency max: %llu us\n", div_u64(max_latency_ns, NSEC_PER_USEC));
+    return 0;
+}
+
+static int swap_cache_open(struct inode* inode, struct file* file) {
+    return single_open(file, swap_cache_show, NULL);
+}
+
+static ssize_t swap_cache_write(struct file* file, const char __user* buf, size_t count, loff_t* ppos) {
+    atomic_long_set(&pages_dropped, 0);
+    atomic_long_set(&pages_queued, 0);
+    atomic_long_set(&pages_refused, 0);
+    atomic_long_set(&batches_written, 0);
+    atomic_long_set(&pages_written, 0);
+    atomic_long_set(&write_errors, 0);
+    atomic64_set(&total_latency_ns, 0);
+    max_latency_ns = 0;
+    return count;
+}
+
+static const struct file_operations swap_cache_fops = {
+    .owner = THIS_MODULE,
+    .open = swap_cache_open,
+    .read = seq_read,
+    .write = swap_cache_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+int swap_cache_init(void) {
+    swap_writeback_wq = create_singlethread_workqueue("phys_mem_swap");
+    if (!swap_writeback_wq) {
+        printk(KERN_WARNING "phys_mem: cannot create the swap writeback workqueue, dirty pages are not written back\n");
+        return -ENOMEM;
+    }
+
+    if (phys_mem_debugfs_dir)
+        swap_cache_file = debugfs_create_file("swap_cache", S_IRUSR | S_IWUSR, phys_mem_debugfs_dir, NULL, &swap_cache_fops);
+
+    return 0;
+}
+
+void swap_cache_exit(void) {
+    unsigned long i;
+
+    /* The batches in flight hold page references; destroying the queue flushes it */
+    if (swap_writeback_wq) {
+        destroy_workqueue(swap_writeback_wq);
+        swap_writeback_wq = NULL;
+    }
+
+    for (i = 0; i < num_pending; i++)
+        put_page(pending[i]);
+    num_pending = 0;
+
+    debugfs_remove(swap_cache_file);
+    swap_cache_file = NULL;
+}
@@ -22,6 +22,9 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 '''
 from kpage  import *
+import os
+import mmap
+import time
 
 
 def find_free_buddy_pfns(pageflags, max_hits):
@@ -55,3 +58,92 @@ def find_anon_pfns(pageflags, max_hits):
                     max_hits -= 1
                 pfn += 1
     return ret
+
+
+def find_dirty_page_cache_pfns(pageflags, max_hits):
+    ret =[]
+    pfn = 0
+    with pageflags.open() as pf:
+        while max_hits:
+                flags = pf.next_record()
+                if  (None == flags):
+                    break
+
+                if (flags.all_set_in(kpageflags.DIRTY | kpageflags.LRU) and not flags.any_set_in(kpageflags.ANON | kpageflags.SWAPBACKED | kpageflags.UNEVICTABLE | kpageflags.NOPAGE | kpageflags.COMPOUND_HEAD | kpageflags.COMPOUND_TAIL)):
+                    ret.append( pfn)
+                    max_hits -= 1
+                pfn += 1
+    return ret
+
+def find_swap_cache_pfns(pageflags, max_hits):
+    ret =[]
+    pfn = 0
+    with pageflags.open() as pf:
+        while max_hits:
+                flags = pf.next_record()
+                if  (None == flags):
+                    break
+
+                if (flags.all_set_in(kpageflags.SWAPCACHE | kpageflags.LRU) and not flags.any_set_in(kpageflags.MMAP | kpageflags.UNEVICTABLE | kpageflags.NOPAGE | kpageflags.COMPOUND_HEAD | kpageflags.COMPOUND_TAIL)):
+                    ret.append( pfn)
+                    max_hits -= 1
+                pfn += 1
+    return ret
+
+
+def find_memory_cgroup_root():
+    with open("/proc/mounts") as mounts:
+        for line in mounts:
+            fields = line.split()
+            if fields[2] == "cgroup" and "memory" in fields[3].split(","):
+                return fields[1]
+    return None
+
+def swap_is_active():
+    with open("/proc/swaps") as swaps:
+        return len(swaps.readlines()) > 1
+
+def start_swap_cache_pages(num_pages, limit_pages):
+    """
+    Creates unmapped swap-cache pages: a child process in a memory cgroup
+    limited to limit_pages dirties num_pages anonymous pages, so that most of
+    them are swapped out, then touches every 8th page. The swap readahead
+    brings the neighbours into the swap cache without mapping them.
+
+    Returns a handle for stop_swap_cache_pages(), or None without swap or
+    memory cgroup.
+    """
+    cgroup_root = find_memory_cgroup_root()
+    if not cgroup_root or not swap_is_active():
+        return None
+
+    cgroup = os.path.join(cgroup_root, "phys_mem_test_%d" % os.getpid())
+    os.mkdir(cgroup)
+    with open(os.path.join(cgroup, "memory.limit_in_bytes"), "w") as limit:
+        limit.write("%d" % (limit_pages * mmap.PAGESIZE))
+
+    ready_r, ready_w = os.pipe()
+    pid = os.fork()
+    if 0 == pid:
+        os.close(ready_r)
+        with open(os.path.join(cgroup, "tasks"), "w") as tasks:
+            tasks.write("%d" % os.getpid())
+        memory = mmap.mmap(-1, num_pages * mmap.PAGESIZE)
+        for page in xrange(num_pages):
+            memory[page * mmap.PAGESIZE] = 'x'
+        for page in xrange(0, num_pages, 8):
+            memory[page * mmap.PAGESIZE]
+        os.write(ready_w, "r")
+        while True:
+            time.sleep(3600)
+
+    os.close(ready_w)
+    os.read(ready_r, 1)
+    os.close(ready_r)
+    return (pid, cgroup)
+
+def stop_swap_cache_pages(handle):
+    pid, cgroup = handle
+    os.kill(pid, 9)
+    os.waitpid(pid, 0)
+    os.rmdir(cgroup)
@@ -31,8 +31,12 @@ import physmem
 import mmap 
 import Helpers
 from kpage  import *
-from Helpers import find_free_buddy_pfns, find_anon_pfns
-from physmem.physmem import SOURCE_FREE_BUDDY_PAGE, SOURCE_HW_POISON_ANON
+from Helpers import find_free_buddy_pfns, find_anon_pfns, find_dirty_page_cache_pfns, find_swap_cache_pfns
+from physmem.physmem import SOURCE_FREE_BUDDY_PAGE, SOURCE_HW_POISON_ANON, SOURCE_DIRTY_PAGE_CACHE, SOURCE_SWAP_CACHE
+import tempfile
+import time
+import os
+import signal
 
 class Test(unittest.TestCase):
 
@@ -48,9 +52,12 @@ class Test(unittest.TestCase):
         self.assertEquals(8,sizeof(x ),"pointer == %d bit, should be  64 bit" % (sizeof(x),))
         self.assertEquals(8,sizeof( POINTER(physmem.Phys_mem_frame_request)),"pointer == %d bit, should be  64 bit" % (sizeof( POINTER(physmem.Phys_mem_frame_request)),))
         self.assertEquals(16,sizeof(physmem.Phys_mem_frame_request),"Phys_mem_frame_request != 16 bytes")
-        self.assertEquals(56,sizeof(physmem.Phys_mem_frame_status),"Phys_mem_frame_status != 56 bytes")
+        self.assertEquals(64,sizeof(physmem.Phys_mem_frame_status),"Phys_mem_frame_status != 64 bytes")
         self.assertEquals(24,sizeof(physmem.Phys_mem_request),"Phys_mem_request != 24 bytes")
         self.assertEquals(16,sizeof(physmem.Mark_page_poison),"Mark_page_poison != 16 bytes")
+        self.assertEquals(24,sizeof(physmem.Phys_mem_layout),"Phys_mem_layout != 24 bytes")
+        self.assertEquals(16,sizeof(physmem.Phys_mem_page_state),"Phys_mem_page_state != 16 bytes")
+        self.assertEquals(32,sizeof(physmem.Phys_mem_page_state_request),"Phys_mem_page_state_request != 32 bytes")
                 
     def tearDown(self):
         pass
@@ -75,7 +82,7 @@ class Test(unittest.TestCase):
     def testIOCTL_no_elements(self):
         with open(self.device_name, "rb") as f:
             # IOCTL: 
-            protocol_version = 1
+            protocol_version = 2
             num_requests = 0
             preq = None
            
@@ -85,7 +92,7 @@ class Test(unittest.TestCase):
     def testIOCTL_invalid_elements(self):
         with open(self.device_name, "rb") as f:
             # IOCTL: 
-            protocol_version = 1
+            protocol_version = 2
             num_requests = 1     # One Element
             preq = None
             
@@ -98,8 +105,8 @@ class Test(unittest.TestCase):
 
     def testIOCTL_invalid_version(self):
         with open(self.device_name, "rb") as f:
-            # IOCTL: 
-            protocol_version = 2
+            # IOCTL: version 1 records are shorter
+            protocol_version = 1
             num_requests = 0
             preq = None
             
@@ -148,9 +155,23 @@ class Test(unittest.TestCase):
                 #print(answer)
                 if (answer.is_claimed()):
                     claimed += 1
+                else:
+                    self.assertNotEqual(physmem.CLAIM_FAILURE_NONE, answer.failure_reason, "No failure reason for pfn %d" % (answer.request.requested_pfn,))
+                    self.assertNotEqual(0, answer.retry_after_ms, "No retry hint for pfn %d" % (answer.request.requested_pfn,))
                     
             print("Claimed: %d of %d" % (claimed, len(requests)))      
             self.assertEqual(0,claimed)
+
+    def test_Class_configure_invalid_pfn_failure_reason(self):
+            # Far beyond any physical memory
+            requests = [physmem.Phys_mem_frame_request(1 << 40, self.allowed_sources)]
+
+            config = self.util_Class_configure(requests)
+
+            answer = config[0]
+            self.assertFalse(answer.is_claimed(), "Claimed a non existing frame")
+            self.assertEqual(physmem.CLAIM_FAILURE_INVALID_PFN, answer.failure_reason, "Expected 'invalid pfn', not %d" % (answer.failure_reason,))
+            self.assertEqual(physmem.CLAIM_RETRY_NEVER, answer.retry_after_ms, "A non existing frame should never be retried")
          
     def test_Class_configure_more_elements(self):
             requests = []
@@ -347,6 +368,61 @@ class Test(unittest.TestCase):
         pfns = find_free_buddy_pfns(pageflags, 0x1000)
         self.configure_mmap_and_test(pfns, SOURCE_FREE_BUDDY_PAGE)
 
+    def test_dirty_page_cache(self):
+        # Dirty some page cache
+        with tempfile.NamedTemporaryFile() as f:
+            f.write("x" * (0x100 * 4096))
+            f.flush()
+
+            pageflags = kpageflags.FlagsDataSource('flags', "/proc/kpageflags")
+            pfns = find_dirty_page_cache_pfns(pageflags, 0x100)
+            self.assertTrue(len(pfns) > 0, "No dirty page-cache pages found")
+
+            requests = [physmem.Phys_mem_frame_request(pfn, SOURCE_DIRTY_PAGE_CACHE) for pfn in pfns]
+
+            # The first request starts the writeback
+            config = self.util_Class_configure(requests)
+            busy = [answer for answer in config if not answer.is_claimed() and physmem.CLAIM_FAILURE_BUSY == answer.failure_reason]
+            self.assertTrue(len(busy) > 0, "No dirty page has been queued for writeback")
+
+            # ... the second one claims the written pages
+            time.sleep(2)
+            config = self.util_Class_configure(requests)
+            claimed = [answer for answer in config if answer.is_claimed()]
+            print("Claimed: %d of %d dirty pages after the writeback" % (len(claimed), len(requests)))
+            self.assertTrue(len(claimed) > 0, "No dirty page has been claimed after the writeback")
+            for answer in claimed:
+                self.assertEqual(SOURCE_DIRTY_PAGE_CACHE, answer.actual_source)
+
+    def test_swap_cache(self):
+        # 64MB dirtied in a 16MB memory cgroup
+        handle = Helpers.start_swap_cache_pages(0x4000, 0x1000)
+        if not handle:
+            raise unittest.SkipTest("No swap or no memory cgroup, cannot create swap-cache pages")
+
+        try:
+            pageflags = kpageflags.FlagsDataSource('flags', "/proc/kpageflags")
+            pfns = find_swap_cache_pfns(pageflags, 0x100)
+            self.assertTrue(len(pfns) > 0, "No unmapped swap-cache pages found")
+
+            requests = [physmem.Phys_mem_frame_request(pfn, SOURCE_SWAP_CACHE) for pfn in pfns]
+
+            # Dirty pages are queued for writeback, so request twice
+            config = self.util_Class_configure(requests)
+            time.sleep(2)
+            config = self.util_Class_configure(requests)
+        finally:
+            Helpers.stop_swap_cache_pages(handle)
+
+        claimed = [answer for answer in config if answer.is_claimed()]
+        print("Claimed: %d of %d swap-cache pages" % (len(claimed), len(requests)))
+        self.assertTrue(len(claimed) > 0, "No swap-cache page has been claimed")
+        for answer in config:
+            if answer.is_claimed():
+                self.assertEqual(SOURCE_SWAP_CACHE, answer.actual_source)
+            else:
+                self.assertNotEqual(physmem.CLAIM_FAILURE_NONE, answer.failure_reason)
+
     def test_pageflags_num_frames(self):
             pageflags = kpageflags.FlagsDataSource('flags', "/proc/kpageflags")
             with pageflags.open() as pf:
@@ -438,6 +514,101 @@ class Test(unittest.TestCase):
     
                             
                       
+    def test_Class_pfn_indexed_layout_and_sliced_mmap(self):
+            allowed_sources = SOURCE_FREE_BUDDY_PAGE
+            pageflags = kpageflags.FlagsDataSource('flags', "/proc/kpageflags")
+
+            requests = []
+            free_buddies = find_free_buddy_pfns( pageflags, 0x100)
+            for pfn in free_buddies:
+                requests.append(physmem.Phys_mem_frame_request(pfn,allowed_sources))
+
+            base_pfn = min(free_buddies)
+            self.device.set_layout(physmem.LAYOUT_PFN_INDEXED, base_pfn)
+            config = self.util_Class_configure(requests)
+
+            claimed = [answer for answer in config if answer.is_claimed()]
+            self.assertTrue( len(claimed) > 0, "No pages claimed using method(s) 0x%x " % (allowed_sources,))
+
+            for answer in claimed:
+                self.assertEqual((answer.pfn - base_pfn) * 4096, answer.vma_offset_of_first_byte, "pfn %d is not placed at its pfn-indexed offset" % (answer.pfn,))
+
+            # Map every claimed frame on its own: the mmap offset selects the slice of the layout
+            for answer in claimed:
+                with self.device.mmap(4096, answer.vma_offset_of_first_byte) as map:
+                    for i in xrange(0,4096):
+                        map.write_byte(chr(i % 0xff))
+                    map.seek(0)
+                    for i in xrange(0,4096):
+                        expected = i % 0xff
+                        found = ord( map.read_byte())
+                        self.assertEqual(expected, found,"Expected value %x at %d, not %x" % (expected,i,found))
+
+            # A mapping beyond the layout is rejected
+            end_of_layout = max([answer.vma_offset_of_first_byte for answer in claimed]) + 4096
+            try:
+                with self.device.mmap(4096, end_of_layout) as map:
+                    self.fail("Mapping beyond the end of the layout should fail")
+            except EnvironmentError:
+                pass
+
+            self.device.set_layout(physmem.LAYOUT_DENSE)
+
+    def test_Class_pfn_indexed_layout_hole_raises_sigbus(self):
+            allowed_sources = SOURCE_FREE_BUDDY_PAGE
+            pageflags = kpageflags.FlagsDataSource('flags', "/proc/kpageflags")
+
+            requests = []
+            free_buddies = find_free_buddy_pfns( pageflags, 0x10)
+            for pfn in free_buddies:
+                requests.append(physmem.Phys_mem_frame_request(pfn,allowed_sources))
+
+            # pfn base_pfn is not requested: offset 0 of the layout is a hole
+            base_pfn = min(free_buddies) - 1
+            self.device.set_layout(physmem.LAYOUT_PFN_INDEXED, base_pfn)
+            config = self.util_Class_configure(requests)
+
+            claimed = [answer for answer in config if answer.is_claimed()]
+            self.assertTrue( len(claimed) > 0, "No pages claimed using method(s) 0x%x " % (allowed_sources,))
+
+            with self.device.mmap(4096, 0) as map:
+                child = os.fork()
+                if 0 == child:
+                    map.read_byte()
+                    os._exit(0)
+
+                (pid, status) = os.waitpid(child, 0)
+                self.assertTrue(os.WIFSIGNALED(status), "Reading a hole of the layout did not fail")
+                self.assertEqual(signal.SIGBUS, os.WTERMSIG(status), "Reading a hole of the layout raised signal %d, not SIGBUS" % (os.WTERMSIG(status),))
+
+            self.device.set_layout(physmem.LAYOUT_DENSE)
+
+    def test_Class_page_state(self):
+            pageflags = kpageflags.FlagsDataSource('flags', "/proc/kpageflags")
+
+            free_buddies = find_free_buddy_pfns( pageflags, 0x100)
+            first_pfn = min(free_buddies)
+            states = self.device.page_state(first_pfn, max(free_buddies) - first_pfn + 1)
+
+            still_free = 0
+            for pfn in free_buddies:
+                state = states[pfn - first_pfn]
+                self.assertFalse(state.flags & kpageflags.NOPAGE, "pfn %d exists, but the page state says NOPAGE: %s" % (pfn, state))
+                self.assertNotEqual(physmem.PAGE_STATE_NONE, state.zone, "pfn %d has no zone: %s" % (pfn, state))
+
+                # The snapshot is taken under zone->lock: BUDDY and the order agree
+                self.assertEqual(bool(state.flags & kpageflags.BUDDY), state.buddy_order != physmem.PAGE_STATE_NONE, "BUDDY flag and buddy order disagree for pfn %d: %s" % (pfn, state))
+                if state.flags & kpageflags.BUDDY:
+                    still_free += 1
+
+            # Racy, but most of them should still be free
+            self.assertTrue(still_free > 0, "None of the %d free buddy pages is free in the page state" % (len(free_buddies),))
+
+            with pageflags.open() as pf:
+                num_frames = pf.num_frames()
+            states = self.device.page_state(num_frames + 0x1000, 1)
+            self.assertTrue(states[0].flags & kpageflags.NOPAGE, "pfn 0x%x beyond the end of memory should be NOPAGE: %s" % (num_frames + 0x1000, states[0]))
+
     def util_Class_configure(self, requests):
             self.device.configure(requests)
             config = self.device.read_configuration()
@@ -454,7 +625,7 @@ class Test(unittest.TestCase):
     def testIOCTL_no_element_but_data(self):
         with open(self.device_name, "rb") as f:
             # IOCTL: 
-            protocol_version = 1
+            protocol_version = 2
             num_requests = 0
             
             pfn_request =  physmem.Phys_mem_frame_request(1,1)
@@ -466,7 +637,7 @@ class Test(unittest.TestCase):
 #    def testIOCTL_one_element(self):
 #        with open(self.device_name, "rb") as f:
 #            # IOCTL: 
-#            protocol_version = 1
+#            protocol_version = 2
 #            num_requests = 1
 #            
 #            pfn_request =  physmem.Phys_mem_frame_request(1,1)